@@ -0,0 +1,163 @@
+// bench-bitmap.c
+//
+// Microbenchmark de la búsqueda de bloques libres en el bitmap
+//   1) Búsqueda en un bloque de bitmap casi lleno: recorrido byte a byte (la versión
+//      anterior de bitmap_set_first_free) contra bitmap_first_zero con cada variante
+//   2) bitmap_set_first_free sobre una imagen de 64 MiB casi llena
+//
+// Uso: ./bench-bitmap [iteraciones]
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vfs.h"
+
+#define BENCH_IMG "bench_bitmap.img"
+#define BENCH_BLOCKS (VFS_MAX_BLOCKS - 1)
+#define BENCH_INODES 1024
+#define BENCH_FREE 256 // bloques libres que quedan al final de la imagen
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int first_zero_bytewise(const uint8_t *buffer) {
+    // Búsqueda original: primer byte distinto de 0xFF y luego bit a bit
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        if (buffer[i] != 0xFF) {
+            for (int b = 0; b < 8; b++)
+                if (!(buffer[i] & (1 << (7 - b))))
+                    return i * 8 + b;
+        }
+    }
+    return -1;
+}
+
+static void bench_kernel(const uint8_t *buffer, long iterations, int expected) {
+    volatile int sink = 0;
+
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++)
+        sink += first_zero_bytewise(buffer);
+    double bytewise = (now_ns() - start) / iterations;
+    printf("  %-10s %8.1f ns/búsqueda\n", "byte a byte", bytewise);
+
+    const char *variants[] = {"scalar", "sse2", "avx2"};
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        if (bitmap_scan_select(variants[v]) != 0) {
+            printf("  %-10s no disponible\n", variants[v]);
+            continue;
+        }
+        if (bitmap_first_zero(buffer, 0, BITS_PER_BLOCK) != expected) {
+            fprintf(stderr, "Error: la variante %s no encontró el bit %d\n", variants[v], expected);
+            exit(EXIT_FAILURE);
+        }
+
+        start = now_ns();
+        for (long i = 0; i < iterations; i++)
+            sink += bitmap_first_zero(buffer, 0, BITS_PER_BLOCK);
+        double ns = (now_ns() - start) / iterations;
+        printf("  %-10s %8.1f ns/búsqueda (x%.1f)\n", variants[v], ns, bytewise / ns);
+    }
+    (void)sink;
+}
+
+static int fill_image(struct vfs_device *dev) {
+    // Marca como ocupados todos los bloques de datos salvo los últimos BENCH_FREE
+    struct superblock sb_struct, *sb = &sb_struct;
+    if (dev_read_superblock(dev, sb) != 0)
+        return -1;
+
+    uint32_t used = sb->total_blocks - BENCH_FREE;
+    for (uint32_t i = 0; i < sb->bitmap_blocks; i++) {
+        uint8_t buffer[BLOCK_SIZE] = {0};
+        uint32_t first = i * BITS_PER_BLOCK;
+        uint32_t bits = sb->total_blocks - first < BITS_PER_BLOCK ? sb->total_blocks - first : BITS_PER_BLOCK;
+        uint32_t set = used > first ? (used - first < bits ? used - first : bits) : 0;
+
+        for (uint32_t b = 0; b < set; b++)
+            buffer[b / 8] |= 1 << (7 - b % 8);
+        sb->bitmap_zeroes[i] = bits - set;
+
+        if (dev_write_block(dev, sb->bitmap_start + i, buffer) != 0)
+            return -1;
+    }
+
+    sb->free_blocks = BENCH_FREE;
+    return dev_write_superblock(dev, sb);
+}
+
+static int bench_alloc(void) {
+    unlink(BENCH_IMG);
+    if (create_block_device(BENCH_IMG, BENCH_BLOCKS, BLOCK_SIZE) != 0) {
+        fprintf(stderr, "Error al crear %s: %s\n", BENCH_IMG, strerror(errno));
+        return -1;
+    }
+
+    struct vfs_device dev_struct, *dev = &dev_struct;
+    if (vfs_open(dev, BENCH_IMG, VFS_OPEN_RDWR) != 0) {
+        fprintf(stderr, "Error al abrir %s: %s\n", BENCH_IMG, strerror(errno));
+        return -1;
+    }
+
+    if (dev_init_superblock(dev, BENCH_BLOCKS, BENCH_INODES, VFS_DEFAULT_FEATURES) != 0) {
+        vfs_close(dev);
+        return -1;
+    }
+
+    const char *variants[] = {"scalar", "sse2", "avx2"};
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        if (bitmap_scan_select(variants[v]) != 0)
+            continue;
+
+        if (fill_image(dev) != 0) {
+            vfs_close(dev);
+            return -1;
+        }
+
+        double start = now_ns();
+        for (int i = 0; i < BENCH_FREE; i++) {
+            if (dev_bitmap_set_first_free(dev) < 0) {
+                vfs_close(dev);
+                return -1;
+            }
+        }
+        double ns = (now_ns() - start) / BENCH_FREE;
+        printf("  %-10s %8.1f ns/bloque asignado\n", variants[v], ns);
+    }
+
+    vfs_close(dev);
+    unlink(BENCH_IMG);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 200000;
+    if (iterations <= 0) {
+        fprintf(stderr, "Uso: %s [iteraciones]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Bloque de bitmap casi lleno: un único bit libre cerca del final
+    uint8_t buffer[BLOCK_SIZE];
+    memset(buffer, 0xFF, sizeof(buffer));
+    int expected = BITS_PER_BLOCK - 13;
+    buffer[expected / 8] &= ~(1 << (7 - expected % 8));
+
+    printf("Búsqueda en un bloque de bitmap casi lleno (%ld iteraciones):\n", iterations);
+    bench_kernel(buffer, iterations, expected);
+
+    printf("bitmap_set_first_free en una imagen de %d bloques con %d libres:\n", BENCH_BLOCKS, BENCH_FREE);
+    if (bench_alloc() != 0) {
+        fprintf(stderr, "Error en la prueba de asignación\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
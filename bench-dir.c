@@ -0,0 +1,197 @@
+// bench-dir.c
+//
+// Microbenchmark del recorrido de bloques de directorio
+//   1) Un bloque de 1 KiB lleno: buscar un nombre que no está y buscar una entrada libre,
+//      con el bucle anterior (strncmp entrada por entrada) contra dir_block_scan con cada variante
+//   2) dev_dir_lookup de un nombre que no está en un directorio de varios bloques, sin índice
+//
+// Uso: ./bench-dir [iteraciones]
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vfs.h"
+
+#define BENCH_IMG "bench_dir.img"
+#define BENCH_BLOCKS 8000
+#define BENCH_INODES 4096
+#define BENCH_FILES 4000 // entradas del directorio, unos 125 bloques
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int find_bytewise(const struct dir_entry *entries, const char *name) {
+    // Bucle original de dir_lookup: nodo-I y strncmp de cada entrada
+    for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
+        if (entries[j].inode == 0)
+            continue;
+        if (strncmp(entries[j].name, name, FILENAME_MAX_LEN) == 0)
+            return (int)j;
+    }
+    return -1;
+}
+
+static int free_bytewise(const struct dir_entry *entries) {
+    // Bucle original de add_dir_entry: primera entrada con nodo-I en 0
+    for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++)
+        if (entries[j].inode == 0)
+            return (int)j;
+    return -1;
+}
+
+static void bench_kernel(const struct dir_entry *entries, long iterations) {
+    // Nombres del mismo largo que los del bloque y con el mismo prefijo: el peor caso para strncmp
+    const char *missing = "archivo_de_prueba_num_99999";
+    volatile int sink = 0;
+
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++)
+        sink += find_bytewise(entries, missing) + free_bytewise(entries);
+    double bytewise = (now_ns() - start) / iterations;
+    printf("  %-10s %8.1f ns/bloque\n", "strncmp", bytewise);
+
+    struct dir_entry key;
+    dir_key_init(&key, missing);
+
+    const char *variants[] = {"scalar", "sse2", "avx2"};
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        if (dir_scan_select(variants[v]) != 0) {
+            printf("  %-10s no disponible\n", variants[v]);
+            continue;
+        }
+
+        uint32_t match, free_mask;
+        dir_block_scan(entries, &key, &match, &free_mask);
+        if (match != 0 || free_mask != 1u << (DIR_ENTRIES_PER_BLOCK - 1)) {
+            fprintf(stderr, "Error: la variante %s dio un resultado incorrecto\n", variants[v]);
+            exit(EXIT_FAILURE);
+        }
+
+        start = now_ns();
+        for (long i = 0; i < iterations; i++) {
+            dir_block_scan(entries, &key, &match, &free_mask);
+            sink += (int)(match + free_mask);
+        }
+        double ns = (now_ns() - start) / iterations;
+        printf("  %-10s %8.1f ns/bloque (x%.1f)\n", variants[v], ns, bytewise / ns);
+    }
+    (void)sink;
+}
+
+static int lookup_bytewise(struct vfs_device *dev, const char *name) {
+    // dir_lookup con el bucle original, para comparar sobre el directorio completo
+    struct inode root;
+    if (dev_read_inode(dev, ROOTDIR_INODE, &root) != 0)
+        return -1;
+
+    struct bmap_cursor cur;
+    bmap_cursor_init(&cur, &root, 0);
+    uint32_t start, count;
+    while (dev_bmap_next(dev, &cur, UINT32_MAX, &start, &count) == 1) {
+        for (uint32_t b = start; b < start + count; b++) {
+            uint8_t data_buf[BLOCK_SIZE];
+            if (dev_read_block(dev, b, data_buf) != 0)
+                return -1;
+            int j = find_bytewise((const struct dir_entry *)data_buf, name);
+            if (j >= 0)
+                return (int)((const struct dir_entry *)data_buf)[j].inode;
+        }
+    }
+    return 0;
+}
+
+static int bench_lookup(long iterations) {
+    unlink(BENCH_IMG);
+    if (create_block_device(BENCH_IMG, BENCH_BLOCKS, BLOCK_SIZE) != 0) {
+        fprintf(stderr, "Error al crear %s: %s\n", BENCH_IMG, strerror(errno));
+        return -1;
+    }
+
+    struct vfs_device dev_struct, *dev = &dev_struct;
+    if (vfs_open(dev, BENCH_IMG, VFS_OPEN_RDWR) != 0) {
+        fprintf(stderr, "Error al abrir %s: %s\n", BENCH_IMG, strerror(errno));
+        return -1;
+    }
+
+    if (dev_init_superblock(dev, BENCH_BLOCKS, BENCH_INODES, VFS_DEFAULT_FEATURES) != 0 ||
+        dev_create_root_dir(dev) != 0) {
+        vfs_close(dev);
+        return -1;
+    }
+
+    // Las entradas apuntan todas al directorio raíz: solo interesa el recorrido
+    for (int i = 0; i < BENCH_FILES; i++) {
+        char name[FILENAME_MAX_LEN];
+        snprintf(name, sizeof(name), "archivo_de_prueba_num_%05d", i);
+        if (dev_add_dir_entry(dev, name, ROOTDIR_INODE) != 0) {
+            vfs_close(dev);
+            return -1;
+        }
+    }
+
+    const char *missing = "archivo_de_prueba_num_99999";
+    long n = iterations / 100 > 0 ? iterations / 100 : 1;
+
+    double start = now_ns();
+    for (long i = 0; i < n; i++)
+        if (lookup_bytewise(dev, missing) != 0) {
+            vfs_close(dev);
+            return -1;
+        }
+    double bytewise = (now_ns() - start) / n;
+    printf("  %-10s %8.1f us/búsqueda\n", "strncmp", bytewise / 1e3);
+
+    const char *variants[] = {"scalar", "sse2", "avx2"};
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        if (dir_scan_select(variants[v]) != 0)
+            continue;
+
+        start = now_ns();
+        for (long i = 0; i < n; i++)
+            if (dev_dir_lookup(dev, missing) != 0) {
+                vfs_close(dev);
+                return -1;
+            }
+        double ns = (now_ns() - start) / n;
+        printf("  %-10s %8.1f us/búsqueda (x%.1f)\n", variants[v], ns / 1e3, bytewise / ns);
+    }
+
+    vfs_close(dev);
+    unlink(BENCH_IMG);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 200000;
+    if (iterations <= 0) {
+        fprintf(stderr, "Uso: %s [iteraciones]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Bloque lleno salvo la última entrada, con nombres largos que comparten el prefijo
+    struct dir_entry entries[DIR_ENTRIES_PER_BLOCK];
+    memset(entries, 0, sizeof(entries));
+    for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK - 1; j++) {
+        entries[j].inode = j + 2;
+        snprintf(entries[j].name, FILENAME_MAX_LEN, "archivo_de_prueba_num_%05u", j);
+    }
+
+    printf("Búsqueda de un nombre y de una entrada libre en un bloque de %d entradas (%ld iteraciones):\n",
+           (int)DIR_ENTRIES_PER_BLOCK, iterations);
+    bench_kernel(entries, iterations);
+
+    printf("dev_dir_lookup de un nombre que no está, en un directorio de %d entradas:\n", BENCH_FILES);
+    if (bench_lookup(iterations) != 0) {
+        fprintf(stderr, "Error en la prueba de búsqueda\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
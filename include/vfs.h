@@ -29,6 +29,11 @@
 #define INODE_MODE_FILE 0x8000  // Archivo regular
 #define INODE_MODE_DIR  0x4000  // Directorio
 
+// Marcas del nodo-I, fuera de los bits de tipo y de permisos
+#define INODE_MODE_EXTENTS 0x0800 // Los bloques se mapean con extents (struct inode_extents), no con punteros
+#define INODE_MODE_INLINE  0x0400 // Los datos están en el nodo-I, en lugar de direct[] e indirect
+#define INODE_MODE_INDEXED 0x0200 // Directorio con índice de hash de sus entradas, ver dir-index.c
+
 #define DEFAULT_PERM 0640       // Permisos por defecto para nuevos archivos
 
 // Longitud máxima del nombre de un archivo o entrada de directorio
@@ -58,8 +63,26 @@ struct superblock {
     uint32_t inode_start;   // Bloque de inicio de la tabla de inodos
     uint32_t bitmap_start;  // Bloque de inicio del bitmap de bloques de datos
     uint32_t data_start;    // Primer bloque de datos disponible
+    uint32_t alloc_hint;    // Donde empieza a buscar la próxima corrida de un archivo nuevo (0: data_start)
+    uint32_t features;      // Opciones elegidas al formatear, VFS_FEATURE_xxx
+    uint32_t ibitmap_start; // Bloque de inicio del bitmap de nodos-I (con VFS_FEATURE_INODE_BITMAP)
+    uint32_t ibitmap_blocks;  // Cantidad de bloques del bitmap de nodos-I
+    uint32_t inode_hint;    // Todos los nodos-I anteriores a este están ocupados (0: ROOTDIR_INODE + 1)
+    uint32_t dir_hint;      // Todas las entradas del directorio raíz anteriores a esta están ocupadas (0: la primera)
 };
 
+// Opciones del filesystem (superblock.features), se eligen con vfs-mkfs -O
+#define VFS_FEATURE_LAZY_ZERO    0x0001 // Los bloques liberados no se llenan con ceros
+#define VFS_FEATURE_INODE_BITMAP 0x0002 // Bitmap de nodos-I ocupados, a continuación del bitmap de bloques
+#define VFS_FEATURE_EXTENTS      0x0004 // Los archivos nuevos mapean sus bloques con extents (INODE_MODE_EXTENTS)
+#define VFS_FEATURE_INLINE_DATA  0x0008 // Los archivos nuevos chicos guardan sus datos en el nodo-I (INODE_MODE_INLINE)
+#define VFS_FEATURE_RELATIME     0x0010 // Las lecturas actualizan atime solo si quedó viejo, ver VFS_ATIME_RELATIME
+#define VFS_FEATURE_NOATIME      0x0020 // Las lecturas no actualizan atime
+#define VFS_FEATURE_DIR_INDEX    0x0040 // El directorio raíz tiene un índice de hash (INODE_MODE_INDEXED)
+
+// Opciones que vfs-mkfs activa por omisión
+#define VFS_DEFAULT_FEATURES (VFS_FEATURE_INODE_BITMAP | VFS_FEATURE_RELATIME)
+
 // Inodo: información sobre un archivo o directorio
 
 // Cantidad de punteros de bloque que caben en un bloque indirecto
@@ -79,7 +102,8 @@ struct inode {
     uint32_t atime;         //  4 Último acceso (timestamp Unix)
     uint32_t mtime;         //  4 Última modificación
     uint32_t ctime;         //  4 Creación
-    uint8_t reserved[6];    //  8 Espacio reservado para alinear a 64 bytes
+    uint32_t dir_index;     //  4 Raíz del índice de hash de un directorio con INODE_MODE_INDEXED
+    uint8_t reserved[2];    //  4 Espacio reservado para alinear a 64 bytes
 };
 
 #define INODE_SIZE (sizeof(struct inode)) // Tamaño del nodo-I
@@ -91,6 +115,56 @@ struct indirect_block {
     uint32_t blocks[NUM_INDIRECT_PTRS];
 };
 
+// Con INODE_MODE_INLINE, los bytes de direct[] e indirect guardan el contenido del archivo
+#define INODE_INLINE_SIZE (sizeof(uint32_t) * (NUM_DIRECT_PTRS + 1))
+
+// Extent: corrida de bloques físicamente contiguos de un archivo
+struct extent {
+    uint16_t logical;       // 2 Primer bloque lógico del archivo que cubre
+    uint16_t len;           // 2 Cantidad de bloques
+    uint32_t start;         // 4 Primer bloque físico
+};
+
+#define NUM_INLINE_EXTENTS 3 // Extents que caben en el nodo-I
+#define NUM_SPILL_EXTENTS ((BLOCK_SIZE - 8) / sizeof(struct extent)) // Extents en un bloque de desborde
+#define MAX_EXTENT_FILE_BLOCKS UINT16_MAX // Límite de bloques de un archivo con extents (in->blocks es de 16 bits)
+
+// Con INODE_MODE_EXTENTS, los 32 bytes de direct[] e indirect del nodo-I guardan esta estructura
+// Si hacen falta más de NUM_INLINE_EXTENTS extents, todos pasan a un bloque de desborde
+struct inode_extents {
+    uint16_t count;         // 2 Extents en ext[], 0 si están en el bloque de desborde
+    uint16_t reserved;      // 2
+    uint32_t spill;         // 4 Bloque de desborde (struct extent_block), 0 si no hay
+    struct extent ext[NUM_INLINE_EXTENTS]; // 24 Ordenados por bloque lógico
+};
+
+// Bloque de desborde de extents
+struct extent_block {
+    uint32_t count;         // 4 Extents en uso
+    uint32_t reserved;      // 4
+    struct extent ext[NUM_SPILL_EXTENTS];
+};
+
+// Cursor para recorrer los bloques de un archivo en orden, ver dev_bmap_next()
+// El bloque indirecto (o el de desborde de extents) se lee una sola vez por recorrido
+struct bmap_cursor {
+    const struct inode *in;     // Nodo-I recorrido; el cursor no lo copia
+    uint32_t index;             // Próximo bloque lógico a devolver
+    uint32_t ext_pos;           // Extent donde continuar la búsqueda, con INODE_MODE_EXTENTS
+    uint32_t map_block;         // Bloque cargado en map, 0 si ninguno
+    union {
+        uint32_t indirect[NUM_INDIRECT_PTRS];
+        struct extent_block extents;
+    } map;
+};
+
+// Archivo abierto para leerlo por partes, ver dev_file_open()
+struct vfs_file {
+    uint32_t inode_number;      // Nodo-I del archivo
+    struct inode in;            // Copia del nodo-I, leída al abrir
+    struct bmap_cursor cur;     // Cursor sobre in; conserva el bloque indirecto entre lecturas
+};
+
 // Entrada en un directorio
 struct dir_entry {
     uint32_t inode;                 // 4 - Número de inodo al que apunta el nombre
@@ -99,38 +173,292 @@ struct dir_entry {
 
 #define DIR_ENTRIES_PER_BLOCK (BLOCK_SIZE / sizeof(struct dir_entry)) // Cantidad de entradas en un bloque
 
+// Índice de hash de un directorio (hashing extensible), en bloques fuera del mapa de bloques del directorio
+#define DIR_INDEX_MAX_DEPTH 7 // Bits del hash que puede usar la raíz: hasta 128 baldes
+
+// Raíz del índice: elige el balde con los depth bits más bajos del hash
+struct dir_index_root {
+    uint32_t depth;         // 4 Bits del hash en uso, se usan los primeros 2^depth baldes
+    uint32_t reserved;      // 4
+    uint32_t buckets[(BLOCK_SIZE - 8) / sizeof(uint32_t)]; // Bloque de cada balde; varios pueden compartir uno
+};
+
+// Una entrada del índice: hash del nombre y posición de la entrada en el directorio
+struct dir_index_entry {
+    uint32_t hash;
+    uint32_t slot;
+};
+
+#define NUM_DIR_INDEX_ENTRIES ((BLOCK_SIZE - 8) / sizeof(struct dir_index_entry)) // Entradas en un balde
+
+// Balde del índice: entradas cuyos hash coinciden en los depth bits más bajos
+struct dir_index_bucket {
+    uint16_t count;         // 2 Entradas en uso
+    uint16_t depth;         // 2 Bits del hash que comparten todas sus entradas
+    uint32_t next;          // 4 Balde de desborde, cuando ya no se puede dividir; 0 si no hay
+    struct dir_index_entry ent[NUM_DIR_INDEX_ENTRIES];
+};
+
+// Modos de apertura de la imagen con vfs_open()
+#define VFS_OPEN_RDONLY 0
+#define VFS_OPEN_RDWR   1
+
+// Cache de bloques: tamaño por defecto, configurable con la variable de entorno VFS_CACHE_BLOCKS (0 la deshabilita)
+#define VFS_CACHE_DEFAULT_BLOCKS 256
+#define VFS_ENV_CACHE_BLOCKS "VFS_CACHE_BLOCKS"
+
+// Cache de nodos-I: habilitada por defecto, VFS_INODE_CACHE=0 la deshabilita
+#define VFS_ENV_INODE_CACHE "VFS_INODE_CACHE"
+
+// Cache de entradas del directorio raíz: habilitada por defecto, VFS_DENTRY_CACHE=0 la deshabilita
+#define VFS_ENV_DENTRY_CACHE "VFS_DENTRY_CACHE"
+
+// Modo de acceso real a la imagen, configurable con la variable de entorno VFS_IO
+#define VFS_IO_PREAD   0 // "pread": pread/pwrite sobre el descriptor (por defecto)
+#define VFS_IO_MMAP    1 // "mmap": lecturas desde la imagen mapeada en memoria, escrituras con pwrite
+#define VFS_IO_MMAP_RW 2 // "mmap-rw": lecturas y escrituras sobre el mapeo, msync en vfs_flush()
+#define VFS_IO_URING   3 // "uring": lotes de lecturas y escrituras asincrónicas con io_uring (solo Linux)
+#define VFS_ENV_IO "VFS_IO"
+
+// Cantidad máxima de pedidos en vuelo con io_uring, configurable con la variable de entorno VFS_QUEUE_DEPTH
+#define VFS_QUEUE_DEFAULT_DEPTH 32
+#define VFS_ENV_QUEUE_DEPTH "VFS_QUEUE_DEPTH"
+
+// Tratamiento de los bloques liberados, configurable con la variable de entorno VFS_ZERO
+#define VFS_ZERO_DEFAULT 0 // según el superbloque: VFS_ZERO_LAZY si tiene VFS_FEATURE_LAZY_ZERO, si no VFS_ZERO_EAGER
+#define VFS_ZERO_EAGER   1 // "eager": se escriben ceros en cada bloque liberado
+#define VFS_ZERO_LAZY    2 // "lazy": solo se marcan libres en el bitmap
+#define VFS_ZERO_PUNCH   3 // "punch": como lazy, y además se devuelve el espacio al host con fallocate
+#define VFS_ENV_ZERO "VFS_ZERO"
+
+// Actualización de atime en las lecturas, configurable con la variable de entorno VFS_ATIME
+#define VFS_ATIME_DEFAULT  0 // según el superbloque: VFS_FEATURE_NOATIME, VFS_FEATURE_RELATIME, o si no VFS_ATIME_STRICT
+#define VFS_ATIME_STRICT   1 // "strict": cada lectura escribe el nodo-I con el nuevo atime
+#define VFS_ATIME_RELATIME 2 // "relatime": solo si atime no es posterior a mtime y ctime, o es de hace más de un día
+#define VFS_ATIME_NOATIME  3 // "noatime": las lecturas nunca escriben
+#define VFS_ENV_ATIME "VFS_ATIME"
+#define VFS_RELATIME_SECONDS (24 * 60 * 60)
+
+// Bloques libres que se dejan detrás de la corrida inicial de un archivo para que pueda crecer contiguo
+#define VFS_ALLOC_SLACK 64
+
+// Cuando el directorio raíz se llena crece al doble de bloques, hasta este máximo por vez
+#define VFS_DIR_GROW_BLOCKS 64
+
+// Variante de búsqueda de bits libres en el bitmap: "scalar", "sse2" o "avx2" (por defecto la mejor disponible)
+#define VFS_ENV_BITMAP_SCAN "VFS_BITMAP_SCAN"
+
+// Variante del recorrido de bloques de directorio: "scalar", "sse2" o "avx2" (por defecto la mejor disponible)
+#define VFS_ENV_DIR_SCAN "VFS_DIR_SCAN"
+
+// Si la variable de entorno VFS_STATS está definida, vfs_close() muestra los contadores por stderr
+#define VFS_ENV_STATS "VFS_STATS"
+
+// Contadores de acceso a la imagen
+struct vfs_stats {
+    uint64_t reads;             // Lecturas reales de la imagen
+    uint64_t writes;            // Escrituras reales en la imagen
+    uint64_t cache_hits;        // Accesos resueltos en la cache
+    uint64_t cache_misses;      // Accesos que no encontraron el bloque en la cache
+    uint64_t cache_evictions;   // Bloques desalojados para hacer lugar
+    uint64_t cache_writebacks;  // Bloques sucios escritos a la imagen
+    uint64_t icache_hits;       // Nodos-I encontrados en la cache de nodos-I
+    uint64_t icache_misses;     // Nodos-I cuyo bloque de la tabla no estaba cargado
+    uint64_t icache_loads;      // Bloques de la tabla de nodos-I leídos
+    uint64_t icache_writebacks; // Bloques de la tabla de nodos-I escritos
+    uint64_t dcache_hits;       // Nombres encontrados en la cache de entradas
+    uint64_t dcache_negative;   // Nombres que la cache de entradas sabe que no están en el directorio
+    uint64_t dcache_misses;     // Nombres que hubo que buscar en el directorio
+    uint64_t dcache_scans;      // Recorridos completos del directorio para cargar la cache de entradas
+    uint64_t bytes_read;        // Bytes leídos de la imagen
+    uint64_t bytes_written;     // Bytes escritos en la imagen
+    uint64_t batch_ns;          // Tiempo total dentro de dev_io_submit(), en nanosegundos
+    uint64_t uring_enters;      // Invocaciones a io_uring_enter
+    uint64_t uring_max_inflight;  // Máxima cantidad de pedidos en vuelo alcanzada
+    uint64_t uring_inflight_sum;  // Suma de pedidos en vuelo en cada io_uring_enter, para el promedio
+};
+
+// Cantidad máxima de bloques contiguos que se mueven en una sola llamada preadv/pwritev
+#define VFS_MAX_IO_BLOCKS 256
+
+// Un bloque a leer o escribir con dev_read_blocks/dev_write_blocks
+struct block_io {
+    uint32_t block; // Número de bloque de la imagen
+    void *buffer;   // BLOCK_SIZE bytes de datos
+};
+
+struct iovec;        // definida en <sys/uio.h>
+struct block_cache;  // definida en block-cache.c
+struct inode_cache;  // definida en inode-cache.c
+struct dentry_cache; // definida en dentry-cache.c
+struct vfs_uring;    // definida en uring.c
+
+// Corrida de bloques físicamente contiguos, la unidad de dev_io_submit()
+struct io_run {
+    uint32_t block;           // Primer bloque de la corrida
+    int iovcnt;               // Cantidad de bloques
+    const struct iovec *iov;  // Un buffer de BLOCK_SIZE bytes por bloque
+};
+
+// Dispositivo de bloques "montado": la imagen se abre una sola vez por comando
+// y todas las funciones dev_xxx reciben este contexto en lugar de image_path
+struct vfs_device {
+    int fd;                      // Descriptor de la imagen abierta
+    int mode;                    // VFS_OPEN_RDONLY o VFS_OPEN_RDWR
+    const char *image_path;      // Ruta de la imagen, solo para mensajes
+    int io_mode;                 // VFS_IO_PREAD, VFS_IO_MMAP, VFS_IO_MMAP_RW o VFS_IO_URING
+    uint8_t *map;                // Imagen mapeada en memoria, NULL en modo VFS_IO_PREAD
+    size_t map_size;             // Tamaño del mapeo en bytes
+    int map_dirty;               // 1 si hubo escrituras sobre el mapeo desde el último msync
+    struct block_cache *cache;   // Cache de bloques con escritura diferida, NULL si está deshabilitada
+    struct inode_cache *icache;  // Cache de nodos-I con escritura diferida, NULL si está deshabilitada
+    struct dentry_cache *dcache; // Cache de entradas del directorio raíz, NULL si está deshabilitada
+    struct vfs_uring *uring;     // Anillo de io_uring en modo VFS_IO_URING, si no NULL
+    int zero_mode;               // VFS_ZERO_xxx, tratamiento de los bloques liberados
+    int atime_mode;              // VFS_ATIME_xxx, actualización de atime en las lecturas
+    struct vfs_stats stats;
+};
+
 // Funciones
+// Las versiones dev_xxx trabajan sobre un dispositivo abierto con vfs_open();
+// las que reciben image_path abren y cierran la imagen en cada invocación.
 
 // read-write-block.c
+int vfs_open(struct vfs_device *dev, const char *image_path, int mode);
+int vfs_flush(struct vfs_device *dev);
+int vfs_close(struct vfs_device *dev);
+void vfs_print_stats(const struct vfs_device *dev);
+int dev_io_read(struct vfs_device *dev, uint32_t block_number, void *buffer);
+int dev_io_write(struct vfs_device *dev, uint32_t block_number, const void *buffer);
+int dev_io_readv(struct vfs_device *dev, uint32_t first_block, const struct iovec *iov, int iovcnt);
+int dev_io_writev(struct vfs_device *dev, uint32_t first_block, const struct iovec *iov, int iovcnt);
+int dev_io_submit(struct vfs_device *dev, int write, const struct io_run *runs, size_t count);
+int dev_io_punch(struct vfs_device *dev, uint32_t first_block, uint32_t count);
+int dev_io_send(struct vfs_device *dev, int out_fd, uint32_t first_block, size_t skip, size_t len, size_t *sent);
+int dev_io_advise(struct vfs_device *dev, uint32_t first_block, uint32_t count);
+int dev_read_block(struct vfs_device *dev, int block_number, void *buffer);
+int dev_write_block(struct vfs_device *dev, int block_number, const void *buffer);
+int dev_read_blocks(struct vfs_device *dev, struct block_io *ios, size_t count);
+int dev_write_blocks(struct vfs_device *dev, const struct block_io *ios, size_t count);
 int read_block(const char *image_path, int block_number, void *buffer);
 int write_block(const char *image_path, int block_number, const void *buffer);
+int read_blocks(const char *image_path, struct block_io *ios, size_t count);
+int write_blocks(const char *image_path, const struct block_io *ios, size_t count);
 int create_block_device(const char *image_path, int total_blocks, int block_size);
 
+// block-cache.c
+int cache_init(struct vfs_device *dev, uint32_t capacity);
+void cache_free(struct vfs_device *dev);
+int cache_read_block(struct vfs_device *dev, uint32_t block, void *buffer);
+int cache_write_block(struct vfs_device *dev, uint32_t block, const void *buffer);
+int cache_peek(struct vfs_device *dev, uint32_t block, void *buffer);
+void cache_update(struct vfs_device *dev, uint32_t block, const void *buffer);
+int cache_flush(struct vfs_device *dev);
+
+// inode-cache.c
+int icache_init(struct vfs_device *dev, int enabled);
+void icache_reset(struct vfs_device *dev);
+void icache_free(struct vfs_device *dev);
+int icache_read(struct vfs_device *dev, uint32_t inode_number, struct inode *in);
+int icache_write(struct vfs_device *dev, uint32_t inode_number, const struct inode *in);
+int icache_read_range(struct vfs_device *dev, uint32_t first, uint32_t count, struct inode *out);
+int icache_prefetch(struct vfs_device *dev, const uint32_t *inode_numbers, size_t count);
+int icache_flush(struct vfs_device *dev);
+
+// dentry-cache.c
+int dcache_init(struct vfs_device *dev, int enabled);
+void dcache_reset(struct vfs_device *dev);
+void dcache_free(struct vfs_device *dev);
+int dcache_lookup(struct vfs_device *dev, const char *name, uint32_t *inode_number, uint32_t *block,
+                  uint32_t *slot);
+void dcache_update(struct vfs_device *dev, const char *name, uint32_t inode_number, uint32_t block,
+                   uint32_t slot);
+int dcache_fill(struct vfs_device *dev, const struct inode *root);
+
+// uring.c
+int uring_init(struct vfs_device *dev, unsigned depth);
+void uring_free(struct vfs_device *dev);
+int uring_submit_runs(struct vfs_device *dev, int write, const struct io_run *runs, size_t count);
+
 // superblock.c
-int init_superblock(const char *image_path, uint32_t total_blocks, uint32_t total_inodes);
+int dev_init_superblock(struct vfs_device *dev, uint32_t total_blocks, uint32_t total_inodes, uint32_t features);
+int dev_read_superblock(struct vfs_device *dev, struct superblock *sb);
+int dev_write_superblock(struct vfs_device *dev, struct superblock *sb);
+int init_superblock(const char *image_path, uint32_t total_blocks, uint32_t total_inodes, uint32_t features);
 int read_superblock(const char *image_path, struct superblock *sb);
 int write_superblock(const char *image_path, struct superblock *sb);
 void print_superblock(const struct superblock *sb);
 
 // inode.c
+int dev_read_inode(struct vfs_device *dev, uint32_t inode_number, struct inode *in);
+int dev_read_inodes(struct vfs_device *dev, uint32_t first, uint32_t count, struct inode *out);
+int dev_inode_prefetch(struct vfs_device *dev, const uint32_t *inode_numbers, size_t count);
+int dev_write_inode(struct vfs_device *dev, uint32_t inode_number, const struct inode *in);
+int dev_free_inode(struct vfs_device *dev, uint32_t inode_number);
+int dev_get_block_number_at(struct vfs_device *dev, struct inode *in, uint16_t index);
+void bmap_cursor_init(struct bmap_cursor *cur, const struct inode *in, uint32_t index);
+int dev_bmap_next(struct vfs_device *dev, struct bmap_cursor *cur, uint32_t max_len, uint32_t *start, uint32_t *len);
+int dev_inode_allocated_blocks(struct vfs_device *dev, const struct inode *in, uint32_t *allocated);
+int dev_create_empty_file_in_free_inode(struct vfs_device *dev, uint16_t perms);
+int dev_inode_append_block(struct vfs_device *dev, struct inode *in, uint32_t new_block_number);
+int dev_inode_append_extent(struct vfs_device *dev, struct inode *in, uint32_t start, uint32_t count);
+int dev_inode_map_extent(struct vfs_device *dev, struct inode *in, uint32_t logical, uint32_t start, uint32_t count);
+uint32_t inode_max_blocks(const struct inode *in);
+int dev_inode_trunc_data(struct vfs_device *dev, struct inode *in);
 int read_inode(const char *image_path, uint32_t inode_number, struct inode *in);
+int read_inodes(const char *image_path, uint32_t first, uint32_t count, struct inode *out);
 int write_inode(const char *image_path, uint32_t inode_number, const struct inode *in);
 int free_inode(const char *image_path, uint32_t inode_number);
 int get_block_number_at(const char *image_path, struct inode *in, uint16_t index);
 int create_empty_file_in_free_inode(const char *image_path, uint16_t perms);
 int inode_append_block(const char *image_path, struct inode *in, uint32_t new_block_number);
+int inode_append_extent(const char *image_path, struct inode *in, uint32_t start, uint32_t count);
+int inode_map_extent(const char *image_path, struct inode *in, uint32_t logical, uint32_t start, uint32_t count);
 int inode_trunc_data(const char *image_path, struct inode *in);
 
 // read-write-data.c
+int dev_inode_read_data(struct vfs_device *dev, uint32_t inode_number, void *data_buf, size_t len, size_t offset);
+int dev_inode_write_data(struct vfs_device *dev, uint32_t inode_number, void *data_buf, size_t len, size_t offset);
+int dev_file_open(struct vfs_device *dev, uint32_t inode_number, struct vfs_file *f);
+int dev_file_pread(struct vfs_device *dev, struct vfs_file *f, void *data_buf, size_t len, size_t offset);
+int dev_file_sendfile(struct vfs_device *dev, struct vfs_file *f, int out_fd, size_t len, size_t offset);
+int dev_file_readahead(struct vfs_device *dev, struct vfs_file *f, size_t len, size_t offset);
+int dev_file_close(struct vfs_device *dev, struct vfs_file *f);
 int inode_read_data(const char *image_path, uint32_t inode_number, void *data_buf, size_t len, size_t offset);
 int inode_write_data(const char *image_path, uint32_t inode_number, void *data_buf, size_t len, size_t offset);
 
+// dir-index.c
+uint32_t dir_hash(const char *name);
+int dev_dir_index_create(struct vfs_device *dev, struct inode *dir);
+int dev_dir_index_lookup(struct vfs_device *dev, struct inode *dir, const char *name, uint32_t *slot);
+int dev_dir_index_insert(struct vfs_device *dev, struct inode *dir, const char *name, uint32_t slot);
+int dev_dir_index_remove(struct vfs_device *dev, struct inode *dir, const char *name, uint32_t slot);
+
+// dir-scan.c
+int dir_scan_select(const char *name);
+const char *dir_scan_name(void);
+void dir_key_init(struct dir_entry *key, const char *name);
+void dir_block_scan(const struct dir_entry *entries, const struct dir_entry *key, uint32_t *match,
+                    uint32_t *free_mask);
+
 // rootdir.c
+int dev_create_root_dir(struct vfs_device *dev);
 int create_root_dir(const char *image_path);
 
 // bitmap.c
+int bitmap_scan_select(const char *name);
+const char *bitmap_scan_name(void);
+int bitmap_first_zero(const uint8_t *buffer, uint32_t from, uint32_t nbits);
+int dev_bitmap_free_block(struct vfs_device *dev, uint32_t block_nbr);
+int dev_bitmap_free_blocks(struct vfs_device *dev, const uint32_t *blocks, size_t count);
+int dev_bitmap_set_first_free(struct vfs_device *dev);
+int dev_bitmap_alloc_extent(struct vfs_device *dev, uint32_t goal, uint32_t want, uint32_t min, uint32_t *start,
+                            uint32_t *len);
 int bitmap_free_block(const char *image_path, uint32_t block_nbr);
+int bitmap_free_blocks(const char *image_path, const uint32_t *blocks, size_t count);
 int bitmap_set_first_free(const char *image_path);
+int bitmap_alloc_extent(const char *image_path, uint32_t goal, uint32_t want, uint32_t min, uint32_t *start,
+                        uint32_t *len);
 void print_bitmap_block(uint8_t *buffer, uint32_t size);
 
 // ls-func.c
@@ -139,8 +467,11 @@ const char *str_file_permissions(uint16_t mode);
 const char *str_user(uint16_t uid);
 const char *str_group(uint16_t gid);
 void str_timestamp(uint32_t ts, char *buffer, size_t size);
-void print_inode(const struct inode *in, uint32_t inode_nbr, const char *filename);
+void print_inode(const struct inode *in, uint32_t blocks, uint32_t inode_nbr, const char *filename);
 int name_is_valid(const char *name);
+int dev_dir_lookup(struct vfs_device *dev, const char *filename);
+int dev_add_dir_entry(struct vfs_device *dev, const char *filename, uint32_t inode_number);
+int dev_remove_dir_entry(struct vfs_device *dev, const char *filename);
 int dir_lookup(const char *image_path, const char *filename);
 int add_dir_entry(const char *image_path, const char *filename, uint32_t inode_number);
 int remove_dir_entry(const char *image_path, const char *filename);
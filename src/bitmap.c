@@ -1,88 +1,493 @@
 // bitmap.c
 
 #include "vfs.h"
+#include <errno.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-int bitmap_free_block(const char *image_path, uint32_t block_nbr) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VFS_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/*
+    Búsqueda del primer bit libre (en 0) de un bloque de bitmap
+
+    Los bits se numeran de izquierda a derecha: el bloque N es el bit más significativo
+    del byte N/8. Leyendo 8 bytes como un entero big-endian ese orden se conserva, y el
+    primer bit en 0 de la palabra w es __builtin_clzll(~w).
+
+    Antes de recorrer palabras, una rutina "skip" saltea los tramos completamente
+    ocupados (0xFF): con AVX2 de a 32 bytes, con SSE2 de a 16, o ninguna (escalar).
+    La variante se elige en tiempo de ejecución según el procesador, y se puede forzar
+    con la variable de entorno VFS_BITMAP_SCAN=scalar|sse2|avx2.
+*/
+
+typedef uint32_t (*skip_full_fn)(const uint8_t *buffer, uint32_t pos, uint32_t end);
+
+static uint32_t skip_full_scalar(const uint8_t *buffer, uint32_t pos, uint32_t end) {
+    (void)buffer;
+    (void)end;
+    return pos; // el recorrido por palabras se encarga
+}
+
+#ifdef VFS_HAVE_X86_SIMD
+__attribute__((target("sse2"))) static uint32_t skip_full_sse2(const uint8_t *buffer, uint32_t pos, uint32_t end) {
+    const __m128i ones = _mm_set1_epi8((char)0xFF);
+    while (pos + 16 <= end) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buffer + pos));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, ones)) != 0xFFFF)
+            break;
+        pos += 16;
+    }
+    return pos;
+}
+
+__attribute__((target("avx2"))) static uint32_t skip_full_avx2(const uint8_t *buffer, uint32_t pos, uint32_t end) {
+    const __m256i ones = _mm256_set1_epi8((char)0xFF);
+    while (pos + 32 <= end) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(buffer + pos));
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, ones)) != 0xFFFFFFFFu)
+            break;
+        pos += 32;
+    }
+    return pos;
+}
+#endif
+
+static skip_full_fn skip_full = NULL;
+static const char *skip_full_name = NULL;
+
+int bitmap_scan_select(const char *name) {
+    // Elige la variante de búsqueda: "scalar", "sse2", "avx2", o NULL para la mejor disponible
+    // Retorna 0, o -1 si la variante pedida no está disponible (se deja la escalar)
+    skip_full = skip_full_scalar;
+    skip_full_name = "scalar";
+
+#ifdef VFS_HAVE_X86_SIMD
+    __builtin_cpu_init();
+    int have_sse2 = __builtin_cpu_supports("sse2");
+    int have_avx2 = __builtin_cpu_supports("avx2");
+
+    if ((name == NULL || strcmp(name, "avx2") == 0) && have_avx2) {
+        skip_full = skip_full_avx2;
+        skip_full_name = "avx2";
+        return 0;
+    }
+    if ((name == NULL || strcmp(name, "sse2") == 0) && have_sse2) {
+        skip_full = skip_full_sse2;
+        skip_full_name = "sse2";
+        return 0;
+    }
+#endif
+
+    if (name == NULL || strcmp(name, "scalar") == 0)
+        return 0;
+    return -1;
+}
+
+static void bitmap_scan_init(void) {
+    // Primera búsqueda: variante pedida en VFS_BITMAP_SCAN, o la mejor disponible
+    const char *name = getenv(VFS_ENV_BITMAP_SCAN);
+    if (name && *name == '\0')
+        name = NULL;
+
+    if (bitmap_scan_select(name) != 0) {
+        fprintf(stderr, "Advertencia: %s=%s no disponible, se usa la mejor variante\n", VFS_ENV_BITMAP_SCAN, name);
+        bitmap_scan_select(NULL);
+    }
+}
+
+const char *bitmap_scan_name(void) {
+    // Nombre de la variante de búsqueda en uso
+    if (!skip_full)
+        bitmap_scan_init();
+    return skip_full_name;
+}
+
+static uint64_t load_be64(const uint8_t *p) {
+    // Lee 8 bytes como entero big-endian, para que el bit 63 sea el primer bit del bitmap
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+int bitmap_first_zero(const uint8_t *buffer, uint32_t from, uint32_t nbits) {
+    // Busca el primer bit en 0 de buffer en el rango [from, nbits); buffer puede abarcar
+    // varios bloques de bitmap consecutivos y se lee de a palabras de 8 bytes completas
+    // Retorna su posición, o -1 si están todos en 1
+    if (!skip_full)
+        bitmap_scan_init();
+
+    if (from >= nbits)
+        return -1;
+
+    uint32_t end = (nbits + 63) / 64 * 8; // bytes a recorrer, en palabras completas
+    uint32_t pos = from / 64 * 8;
+
+    // Primera palabra: descartar los bits anteriores a from
+    uint64_t free_bits = ~load_be64(buffer + pos) & (~0ULL >> (from % 64));
+    pos += 8;
+
+    while (!free_bits && pos < end) {
+        pos = skip_full(buffer, pos, end);
+        if (pos >= end)
+            break;
+        free_bits = ~load_be64(buffer + pos);
+        pos += 8;
+    }
+
+    if (!free_bits)
+        return -1;
+
+    uint32_t bit = (pos - 8) * 8 + (uint32_t)__builtin_clzll(free_bits);
+    return bit < nbits ? (int)bit : -1;
+}
+
+static uint32_t bitmap_first_one(const uint8_t *buffer, uint32_t from, uint32_t nbits) {
+    // Busca el primer bit en 1 de buffer en el rango [from, nbits), es decir el fin de una
+    // corrida de bloques libres. Retorna su posición, o nbits si no hay ninguno
+    if (from >= nbits)
+        return nbits;
+
+    uint32_t end = (nbits + 63) / 64 * 8;
+    uint32_t pos = from / 64 * 8;
+
+    uint64_t used_bits = load_be64(buffer + pos) & (~0ULL >> (from % 64));
+    pos += 8;
+
+    while (!used_bits && pos < end) {
+        used_bits = load_be64(buffer + pos);
+        pos += 8;
+    }
+
+    if (!used_bits)
+        return nbits;
+
+    uint32_t bit = (pos - 8) * 8 + (uint32_t)__builtin_clzll(used_bits);
+    return bit < nbits ? bit : nbits;
+}
+
+static void bitmap_set_range(uint8_t *buffer, uint32_t start, uint32_t len) {
+    // Marca como ocupados los bits [start, start + len): bytes completos con memset, bordes bit a bit
+    uint32_t bit = start, end = start + len;
+
+    while (bit < end && bit % 8) {
+        buffer[bit / 8] |= 1 << (7 - bit % 8);
+        bit++;
+    }
+
+    if (end - bit >= 8) {
+        memset(buffer + bit / 8, 0xFF, (end - bit) / 8);
+        bit += (end - bit) / 8 * 8;
+    }
+
+    while (bit < end) {
+        buffer[bit / 8] |= 1 << (7 - bit % 8);
+        bit++;
+    }
+}
+
+static int find_free_run(const uint8_t *bitmap, uint32_t from, uint32_t to, uint32_t want, uint32_t *best_start,
+                         uint32_t *best_len) {
+    // Recorre las corridas de bits en 0 de [from, to) y actualiza en *best_start/*best_len la más larga
+    // Retorna 1 al encontrar la primera de al menos want bloques, 0 si no hay ninguna
+    uint32_t pos = from;
+    while (pos < to) {
+        int run_start = bitmap_first_zero(bitmap, pos, to);
+        if (run_start == -1)
+            break;
+
+        uint32_t run_end = bitmap_first_one(bitmap, run_start, to);
+        uint32_t run_len = run_end - run_start;
+
+        if (run_len > *best_len) {
+            *best_start = run_start;
+            *best_len = run_len;
+        }
+        if (run_len >= want)
+            return 1;
+        pos = run_end;
+    }
+    return 0;
+}
+
+int dev_bitmap_alloc_extent(struct vfs_device *dev, uint32_t goal, uint32_t want, uint32_t min, uint32_t *start,
+                            uint32_t *len) {
     /*
-        Escribe un cero en la posicion block_nbr del bitmap
+        Busca y marca como ocupada una corrida de bloques libres contiguos, empezando en goal si se puede
         Pasos:
-            Verifica que block_nbr sea válido.
-            Calcula en qué bloque de bitmap se encuentra.
-            Lee ese bloque de bitmap.
-            Desmarca el bit correspondiente (lo pone en 0).
-            Actualiza bitmap_zeroes[] y free_blocks en el superbloque.
-            Escribe el bitmap y el superbloque actualizados.
+            Lee el superbloque y todos los bloques de bitmap, como un único arreglo de bits.
+            Si el bloque goal está libre (normalmente el siguiente al último bloque del archivo),
+            toma la corrida que empieza ahí, aunque sea más corta que want: el archivo sigue contiguo.
+            Si no (goal 0 para un archivo nuevo, o goal ocupado), busca a partir de alloc_hint del
+            superbloque hasta el final y luego desde el comienzo: toma la primera corrida de al
+            menos want bloques o, si no hay, la más larga encontrada.
+            Si la corrida tiene menos de min bloques, falla.
+            Marca los bits, actualiza bitmap_zeroes[], free_blocks y alloc_hint una sola vez,
+            y escribe solo los bloques de bitmap modificados.
+        alloc_hint rota por la imagen: cada corrida que empieza una zona nueva deja detrás
+        VFS_ALLOC_SLACK bloques libres, para que ese archivo crezca ahí sin intercalarse con otros.
+        Retorna 0 y deja en *start y *len la corrida asignada (*len entre min y want),
+        o -1 en caso de error o si no hay una corrida de min bloques
     */
     struct superblock sb_struct, *sb = &sb_struct;
 
-    if (read_superblock(image_path, sb) != 0) {
+    if (want == 0 || min == 0 || min > want) {
+        fprintf(stderr, "Error: tamaño de extent inválido (want %u, min %u)\n", want, min);
+        return -1;
+    }
+
+    if (dev_read_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error al leer superblock\n");
         return -1;
     }
 
-    if (block_nbr <= sb->data_start || block_nbr >= sb->total_blocks) { // controla no liberar el directorio raiz
-        fprintf(stderr, "Error: número de bloque inválido (%u)\n", block_nbr);
+    if (sb->free_blocks < min) {
+        fprintf(stderr, "Error: no hay bloques libres\n");
         return -1;
     }
 
-    // Calcular en qué bloque de bitmap y en qué posición dentro de ese bloque está el bit
+    uint8_t bitmap[MAX_INODE_BLOCKS * BLOCK_SIZE];
+    for (uint32_t i = 0; i < sb->bitmap_blocks; i++) {
+        if (dev_read_block(dev, sb->bitmap_start + i, bitmap + i * BLOCK_SIZE) != 0) {
+            fprintf(stderr, "Error: no se pudo leer el bloque de bitmap %u\n", sb->bitmap_start + i);
+            return -1;
+        }
+    }
 
-    uint32_t bitmap_block_offset = block_nbr / BITS_PER_BLOCK; // en que bloque está el bit
-    uint32_t in_block_bit_index = block_nbr % BITS_PER_BLOCK;  // en qué número de bit de ese bloque
-    uint32_t byte_index = in_block_bit_index / 8;              // en qué byte de ese bloque
-    uint32_t bit_index = in_block_bit_index % 8;               // en qué bit de ese byte (izq a der)
-    uint32_t bit_mask = 1 << (7 - bit_index);                  // la máscara por ej. 00100000
+    uint32_t best_start = 0, best_len = 0;
+    int next_fit = 1;
 
-    // Leer el bloque de bitmap correspondiente
-    uint8_t bitmap_buffer[BLOCK_SIZE];
-    int bitmap_block_num = sb->bitmap_start + bitmap_block_offset;
-    DEBUG_PRINT("Número de bloque del bitmap es %d.\n", bitmap_block_num);
-    DEBUG_PRINT("Número de bit en el bloque bitmap es %u.\n", in_block_bit_index);
+    if (goal >= sb->data_start && goal < sb->total_blocks && !(bitmap[goal / 8] & (1 << (7 - goal % 8)))) {
+        // El bloque pedido está libre: continuar justo a continuación
+        best_start = goal;
+        best_len = bitmap_first_one(bitmap, goal, sb->total_blocks) - goal;
+        next_fit = best_len < min;
+    }
+
+    if (next_fit) {
+        // Buscar desde la pista hacia el final, y luego desde el comienzo
+        goal = sb->alloc_hint;
+        if (goal < sb->data_start || goal >= sb->total_blocks)
+            goal = sb->data_start;
+
+        best_len = 0;
+        if (!find_free_run(bitmap, goal, sb->total_blocks, want, &best_start, &best_len))
+            find_free_run(bitmap, sb->data_start, goal, want, &best_start, &best_len);
+    }
 
-    if (read_block(image_path, bitmap_block_num, bitmap_buffer) != 0) {
-        fprintf(stderr, "Error al leer bloque de bitmap %d\n", bitmap_block_num);
+    if (best_len < min) {
+        fprintf(stderr, "Error: no hay %u bloques libres contiguos\n", min);
         return -1;
     }
 
-    // Verificar que el bit estaba en 1
-    if (!(bitmap_buffer[byte_index] & bit_mask)) {
-        DEBUG_PRINT("Advertencia: el bloque %u ya estaba libre\n", block_nbr);
+    if (best_len > want)
+        best_len = want;
+
+    DEBUG_PRINT("Extent asignado: bloques %u a %u (goal %u).\n", best_start, best_start + best_len - 1, goal);
+    bitmap_set_range(bitmap, best_start, best_len);
+
+    // Escribir los bloques de bitmap que abarca la corrida y actualizar sus contadores
+    uint32_t first_bb = best_start / BITS_PER_BLOCK;
+    uint32_t last_bb = (best_start + best_len - 1) / BITS_PER_BLOCK;
+    for (uint32_t bb = first_bb; bb <= last_bb; bb++) {
+        uint32_t from = bb * BITS_PER_BLOCK > best_start ? bb * BITS_PER_BLOCK : best_start;
+        uint32_t to = (bb + 1) * BITS_PER_BLOCK < best_start + best_len ? (bb + 1) * BITS_PER_BLOCK
+                                                                           : best_start + best_len;
+        sb->bitmap_zeroes[bb] -= to - from;
+
+        if (dev_write_block(dev, sb->bitmap_start + bb, bitmap + bb * BLOCK_SIZE) != 0) {
+            fprintf(stderr, "Error: no se pudo escribir el bloque de bitmap %u\n", sb->bitmap_start + bb);
+            return -1;
+        }
+    }
+
+    // Una corrida que empieza una zona nueva deja VFS_ALLOC_SLACK bloques libres detrás;
+    // la continuación de un archivo solo corre la pista si la pasó
+    uint32_t end = best_start + best_len;
+    uint32_t hint = sb->alloc_hint;
+    if (next_fit)
+        hint = end + VFS_ALLOC_SLACK;
+    else if (end > hint)
+        hint = end;
+
+    sb->free_blocks -= best_len;
+    sb->alloc_hint = hint < sb->total_blocks ? hint : sb->data_start;
+    if (dev_write_superblock(dev, sb) != 0) {
+        fprintf(stderr, "Error: no se pudo escribir el superbloque\n");
+        return -1;
+    }
+
+    *start = best_start;
+    *len = best_len;
+    return 0;
+}
+
+int dev_bitmap_free_block(struct vfs_device *dev, uint32_t block_nbr) {
+    // Pone en cero la posición block_nbr del bitmap: es un lote de un solo bloque, ver dev_bitmap_free_blocks
+    return dev_bitmap_free_blocks(dev, &block_nbr, 1);
+}
+
+static int compare_blocks(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int free_blocks_zero(struct vfs_device *dev, const struct superblock *sb, const struct block_io *ios,
+                            size_t count) {
+    // Trata el contenido de los bloques recién liberados (ordenados) según dev->zero_mode:
+    //   eager  escribe ceros en todos, con una escritura por corrida contigua
+    //   lazy   no hace nada: inode_write_data llena con ceros en memoria los bloques nuevos
+    //          que no se escriben completos, así nunca se lee contenido viejo
+    //   punch  como lazy, y además devuelve el espacio al host con dev_io_punch
+    // Retorna 0 o -1 en caso de error
+    int zero_mode = dev->zero_mode;
+    if (zero_mode == VFS_ZERO_DEFAULT)
+        zero_mode = (sb->features & VFS_FEATURE_LAZY_ZERO) ? VFS_ZERO_LAZY : VFS_ZERO_EAGER;
+
+    if (zero_mode == VFS_ZERO_EAGER) {
+        DEBUG_PRINT("Escribiendo ceros en %zu bloques que quedaron libres\n", count);
+        if (dev_write_blocks(dev, ios, count) != 0) {
+            fprintf(stderr, "Error al limpiar los bloques liberados\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    if (zero_mode != VFS_ZERO_PUNCH)
         return 0;
+
+    for (size_t i = 0; i < count;) {
+        size_t n = 1;
+        while (i + n < count && ios[i + n].block == ios[i].block + n)
+            n++;
+
+        if (dev_io_punch(dev, ios[i].block, n) != 0) {
+            DEBUG_PRINT("No se pudo liberar el espacio de los bloques %u a %u: %s\n", ios[i].block,
+                        ios[i].block + (uint32_t)n - 1, strerror(errno));
+            return 0; // no es un error: los bloques quedan como en modo lazy
+        }
+
+        // la imagen ahora tiene ceros ahí; actualizar las copias que estén en la cache
+        for (size_t j = i; j < i + n && dev->cache; j++)
+            cache_update(dev, ios[j].block, ios[j].buffer);
+        i += n;
     }
 
-    // Marcar el bit como libre
-    bitmap_buffer[byte_index] &= ~bit_mask;
+    return 0;
+}
+
+int dev_bitmap_free_blocks(struct vfs_device *dev, const uint32_t *blocks, size_t count) {
+    /*
+        Libera un conjunto de bloques en lote
+        Pasos:
+            Ordena una copia de la lista de bloques.
+            Recorre la lista de a un bloque de bitmap: lo lee una vez, pone en 0 todos
+            sus bits de la lista y lo escribe una vez.
+            Según el modo de ceros, escribe ceros en los bloques liberados, con una escritura
+            por corrida contigua, o no los toca (ver free_blocks_zero).
+            Actualiza bitmap_zeroes[] y free_blocks y escribe el superbloque una sola vez.
+        Los bloques inválidos se informan y se saltean; los que ya estaban libres se ignoran
+        Retorna 0, o -1 si hubo algún error
+    */
+    if (count == 0)
+        return 0;
 
-    // Escribir el bloque de bitmap actualizado
-    if (write_block(image_path, bitmap_block_num, bitmap_buffer) != 0) {
-        fprintf(stderr, "Error al escribir bloque de bitmap %d\n", bitmap_block_num);
+    struct superblock sb_struct, *sb = &sb_struct;
+    if (dev_read_superblock(dev, sb) != 0) {
+        fprintf(stderr, "Error al leer superblock\n");
         return -1;
     }
 
-    // Escribir ceros en el bloque de datos liberado
-    DEBUG_PRINT("Escribiendo ceros en bloque %u que quedo libre\n", block_nbr);
-    uint8_t zero_buf[BLOCK_SIZE] = {0};
-    if (write_block(image_path, block_nbr, zero_buf) != 0) {
-        fprintf(stderr, "Error al limpiar bloque %u.\n", block_nbr);
+    uint32_t *sorted = malloc(count * sizeof(uint32_t));
+    struct block_io *zero_ios = malloc(count * sizeof(struct block_io));
+    if (!sorted || !zero_ios) {
+        fprintf(stderr, "Error: no hay memoria para liberar %zu bloques\n", count);
+        free(sorted);
+        free(zero_ios);
         return -1;
     }
 
-    // Actualizar metadata del superbloque
-    sb->bitmap_zeroes[bitmap_block_offset]++;
-    sb->free_blocks++;
+    memcpy(sorted, blocks, count * sizeof(uint32_t));
+    qsort(sorted, count, sizeof(uint32_t), compare_blocks);
+
+    static uint8_t zero_buf[BLOCK_SIZE];
+    uint8_t bitmap_buffer[BLOCK_SIZE];
+    size_t freed = 0;
+    int ret = 0;
+
+    size_t i = 0;
+    while (i < count) {
+        uint32_t block_nbr = sorted[i];
+        if (block_nbr <= sb->data_start || block_nbr >= sb->total_blocks) { // controla no liberar el directorio raiz
+            fprintf(stderr, "Error: número de bloque inválido (%u)\n", block_nbr);
+            ret = -1;
+            i++;
+            continue;
+        }
+
+        // Todos los bloques de la lista que caen en este bloque de bitmap
+        uint32_t bitmap_block_offset = block_nbr / BITS_PER_BLOCK;
+        uint32_t bitmap_block_num = sb->bitmap_start + bitmap_block_offset;
+        if (dev_read_block(dev, bitmap_block_num, bitmap_buffer) != 0) {
+            fprintf(stderr, "Error al leer bloque de bitmap %u\n", bitmap_block_num);
+            ret = -1;
+            break;
+        }
+
+        size_t cleared = 0;
+        for (; i < count && sorted[i] / BITS_PER_BLOCK == bitmap_block_offset && sorted[i] < sb->total_blocks; i++) {
+            if (i > 0 && sorted[i] == sorted[i - 1])
+                continue; // repetido
+
+            uint32_t bit = sorted[i] % BITS_PER_BLOCK;
+            uint8_t mask = 1 << (7 - bit % 8);
+            if (!(bitmap_buffer[bit / 8] & mask)) {
+                DEBUG_PRINT("Advertencia: el bloque %u ya estaba libre\n", sorted[i]);
+                continue;
+            }
+
+            bitmap_buffer[bit / 8] &= ~mask;
+            zero_ios[freed].block = sorted[i];
+            zero_ios[freed].buffer = zero_buf;
+            freed++;
+            cleared++;
+        }
 
-    if (write_superblock(image_path, sb) != 0) {
+        if (cleared == 0)
+            continue;
+
+        if (dev_write_block(dev, bitmap_block_num, bitmap_buffer) != 0) {
+            fprintf(stderr, "Error al escribir bloque de bitmap %u\n", bitmap_block_num);
+            freed -= cleared;
+            ret = -1;
+            break;
+        }
+
+        sb->bitmap_zeroes[bitmap_block_offset] += cleared;
+        sb->free_blocks += cleared;
+    }
+
+    if (freed > 0 && free_blocks_zero(dev, sb, zero_ios, freed) != 0)
+        ret = -1;
+
+    if (freed > 0 && dev_write_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error al escribir superbloque\n");
-        return -1;
+        ret = -1;
     }
 
-    return 0;
+    free(sorted);
+    free(zero_ios);
+    return ret;
 }
 
-int bitmap_set_first_free(const char *image_path) {
+int dev_bitmap_set_first_free(struct vfs_device *dev) {
     // Busca el primer bloque libre en el bitmap, lo marca como ocupado y lo retorna.
     // Retorna -1 en caso de error o si no hay bloques libres disponibles.
 
@@ -90,7 +495,7 @@ int bitmap_set_first_free(const char *image_path) {
     // Leer el superbloque para validar si hay bloques disponibles
     struct superblock sb_struct, *sb = &sb_struct;
 
-    if (read_superblock(image_path, sb) != 0) {
+    if (dev_read_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error al leer superblock\n");
         return -1;
     }
@@ -118,52 +523,30 @@ int bitmap_set_first_free(const char *image_path) {
     // Paso 3: leer el bloque de bitmap
     uint8_t bitmap_buffer[BLOCK_SIZE];
     int bitmap_block_num = sb->bitmap_start + bitmap_block_offset;
-    if (read_block(image_path, bitmap_block_num, bitmap_buffer) != 0) {
+    if (dev_read_block(dev, bitmap_block_num, bitmap_buffer) != 0) {
         fprintf(stderr, "Error: no se pudo leer el bloque de bitmap\n");
         return -1;
     }
 
-    // Paso 4: encontrar primer byte con algún bit libre
-    int byte_index = -1;
-    for (int i = 0; i < BLOCK_SIZE; i++) {
-        if (bitmap_buffer[i] != 0xFF) {
-            byte_index = i;
-            break;
-        }
-    }
-
-    if (byte_index == -1) {
+    // Paso 4: encontrar el primer bit libre y marcarlo como ocupado
+    int bit_index = bitmap_first_zero(bitmap_buffer, 0, BITS_PER_BLOCK);
+    if (bit_index == -1) {
         fprintf(stderr, "Error: inconsistencia: bitmap parece lleno pero metadata indica espacio\n");
         return -1;
     }
 
-    // Paso 5: encontrar primer bit libre en ese byte (de izquierda a derecha)
-    int bit_index = -1;
-    for (int b = 0; b < 8; b++) {
-        uint8_t mask = 1 << (7 - b); // bit shift a la izquierda
-        if (!(bitmap_buffer[byte_index] & mask)) {
-            // Marcar el bit como ocupado
-            bitmap_buffer[byte_index] |= mask;
-            bit_index = b;
-            break;
-        }
-    }
+    bitmap_buffer[bit_index / 8] |= 1 << (7 - bit_index % 8);
 
-    if (bit_index == -1) {
-        fprintf(stderr, "Error: inconsistencia en el byte del bitmap\n");
-        return -1;
-    }
-
-    // Paso 6: calcular número de bloque, usando
-    uint32_t block_number = bitmap_block_offset * BLOCK_SIZE * 8 + byte_index * 8 + bit_index;
+    // Paso 5: calcular número de bloque
+    uint32_t block_number = bitmap_block_offset * BITS_PER_BLOCK + bit_index;
 
     if (block_number >= sb->total_blocks) {
         fprintf(stderr, "Error: número de bloque fuera de rango\n");
         return -1;
     }
 
-    // Paso 7: escribir bloque de bitmap y actualizar superbloque
-    if (write_block(image_path, bitmap_block_num, bitmap_buffer) != 0) {
+    // Paso 6: escribir bloque de bitmap y actualizar superbloque
+    if (dev_write_block(dev, bitmap_block_num, bitmap_buffer) != 0) {
         fprintf(stderr, "Error: no se pudo escribir el bloque de bitmap\n");
         return -1;
     }
@@ -171,7 +554,7 @@ int bitmap_set_first_free(const char *image_path) {
     sb->bitmap_zeroes[bitmap_block_offset]--;
     sb->free_blocks--;
 
-    if (write_superblock(image_path, sb) != 0) {
+    if (dev_write_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error: no se pudo escribir el superbloque\n");
         return -1;
     }
@@ -197,3 +580,50 @@ void print_bitmap_block(uint8_t *buffer, uint32_t size) {
             putchar('\n');
     }
 }
+
+// Versiones por image_path, se mantienen por compatibilidad
+
+int bitmap_free_block(const char *image_path, uint32_t block_nbr) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_bitmap_free_block(&dev, block_nbr);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
+
+int bitmap_alloc_extent(const char *image_path, uint32_t goal, uint32_t want, uint32_t min, uint32_t *start,
+                        uint32_t *len) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_bitmap_alloc_extent(&dev, goal, want, min, start, len);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
+
+int bitmap_free_blocks(const char *image_path, const uint32_t *blocks, size_t count) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_bitmap_free_blocks(&dev, blocks, count);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
+
+int bitmap_set_first_free(const char *image_path) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_bitmap_set_first_free(&dev);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
@@ -0,0 +1,318 @@
+// block-cache.c
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "vfs.h"
+
+/*
+    Cache de bloques con politica LRU y escritura diferida (write-back)
+    Se ubica entre dev_read_block/dev_write_block y el acceso real a la imagen:
+        - una lectura que encuentra el bloque en la cache no hace ninguna llamada al sistema
+        - una escritura solo modifica la copia en memoria y la marca "sucia"
+        - los bloques sucios se escriben al desalojarlos o al invocar vfs_flush()
+    Las entradas se ubican por numero de bloque en una tabla hash, y se mantienen
+    en una lista doblemente enlazada ordenada por uso: la cabeza es la mas reciente.
+
+    Los bloques de datos de archivos se mueven con dev_read_blocks/dev_write_blocks,
+    que no cargan bloques en la cache: solo consultan (cache_peek) o actualizan
+    (cache_update) los que ya estan, para no desalojar la metadata con datos.
+*/
+
+struct cache_entry {
+    uint32_t block;             // Número de bloque de la imagen
+    int dirty;                  // 1 si la copia en memoria difiere de la imagen
+    struct cache_entry *prev;   // Lista LRU, hacia la entrada más reciente
+    struct cache_entry *next;   // Lista LRU, hacia la entrada menos reciente
+    struct cache_entry *hnext;  // Siguiente entrada en el mismo bucket de la tabla hash
+    uint8_t data[BLOCK_SIZE];
+};
+
+struct block_cache {
+    uint32_t capacity;          // Cantidad máxima de bloques en memoria
+    uint32_t count;             // Cantidad actual de bloques en memoria
+    uint32_t hash_mask;         // Cantidad de buckets - 1 (potencia de 2)
+    struct cache_entry **hash;
+    struct cache_entry *head;   // Más recientemente usada
+    struct cache_entry *tail;   // Menos recientemente usada, la próxima a desalojar
+};
+
+int cache_init(struct vfs_device *dev, uint32_t capacity) {
+    // Crea la cache de hasta capacity bloques. Las entradas se reservan a medida que se usan
+    // Retorna 0 o -1 en caso de error
+
+    dev->cache = NULL;
+    if (capacity == 0)
+        return 0; // cache deshabilitada
+
+    uint32_t buckets = 1;
+    while (buckets < capacity)
+        buckets <<= 1;
+
+    struct block_cache *cache = calloc(1, sizeof(struct block_cache));
+    if (!cache)
+        return -1;
+
+    cache->hash = calloc(buckets, sizeof(struct cache_entry *));
+    if (!cache->hash) {
+        free(cache);
+        return -1;
+    }
+
+    cache->capacity = capacity;
+    cache->hash_mask = buckets - 1;
+    dev->cache = cache;
+    return 0;
+}
+
+void cache_free(struct vfs_device *dev) {
+    // Libera la cache sin escribir los bloques sucios, ver cache_flush()
+    struct block_cache *cache = dev->cache;
+    if (!cache)
+        return;
+
+    struct cache_entry *e = cache->head;
+    while (e) {
+        struct cache_entry *next = e->next;
+        free(e);
+        e = next;
+    }
+
+    free(cache->hash);
+    free(cache);
+    dev->cache = NULL;
+}
+
+static struct cache_entry *cache_find(struct block_cache *cache, uint32_t block) {
+    struct cache_entry *e = cache->hash[block & cache->hash_mask];
+    while (e && e->block != block)
+        e = e->hnext;
+    return e;
+}
+
+static void lru_unlink(struct block_cache *cache, struct cache_entry *e) {
+    if (e->prev)
+        e->prev->next = e->next;
+    else
+        cache->head = e->next;
+
+    if (e->next)
+        e->next->prev = e->prev;
+    else
+        cache->tail = e->prev;
+
+    e->prev = e->next = NULL;
+}
+
+static void lru_push_front(struct block_cache *cache, struct cache_entry *e) {
+    e->prev = NULL;
+    e->next = cache->head;
+    if (cache->head)
+        cache->head->prev = e;
+    cache->head = e;
+    if (!cache->tail)
+        cache->tail = e;
+}
+
+static void hash_unlink(struct block_cache *cache, struct cache_entry *e) {
+    struct cache_entry **pp = &cache->hash[e->block & cache->hash_mask];
+    while (*pp != e)
+        pp = &(*pp)->hnext;
+    *pp = e->hnext;
+    e->hnext = NULL;
+}
+
+static int cache_writeback(struct vfs_device *dev, struct cache_entry *e) {
+    if (!e->dirty)
+        return 0;
+
+    if (dev_io_write(dev, e->block, e->data) != 0)
+        return -1;
+
+    e->dirty = 0;
+    dev->stats.cache_writebacks++;
+    return 0;
+}
+
+static struct cache_entry *cache_get_entry(struct vfs_device *dev, uint32_t block) {
+    // Obtiene una entrada libre para block: reserva una nueva o desaloja la menos usada
+    // La entrada queda en la tabla hash y al frente de la lista LRU, con datos indefinidos
+    struct block_cache *cache = dev->cache;
+    struct cache_entry *e;
+
+    if (cache->count < cache->capacity) {
+        e = malloc(sizeof(struct cache_entry));
+        if (!e)
+            return NULL;
+        cache->count++;
+    } else {
+        e = cache->tail;
+        if (cache_writeback(dev, e) != 0)
+            return NULL;
+
+        DEBUG_PRINT("Cache: desalojando bloque %u\n", e->block);
+        lru_unlink(cache, e);
+        hash_unlink(cache, e);
+        dev->stats.cache_evictions++;
+    }
+
+    e->block = block;
+    e->dirty = 0;
+    e->hnext = cache->hash[block & cache->hash_mask];
+    cache->hash[block & cache->hash_mask] = e;
+    lru_push_front(cache, e);
+    return e;
+}
+
+int cache_read_block(struct vfs_device *dev, uint32_t block, void *buffer) {
+    // Lee un bloque a través de la cache. Retorna 0 o -1 en caso de error
+    struct block_cache *cache = dev->cache;
+    struct cache_entry *e = cache_find(cache, block);
+
+    if (e) {
+        dev->stats.cache_hits++;
+        lru_unlink(cache, e);
+        lru_push_front(cache, e);
+        memcpy(buffer, e->data, BLOCK_SIZE);
+        return 0;
+    }
+
+    dev->stats.cache_misses++;
+    e = cache_get_entry(dev, block);
+    if (!e)
+        return -1;
+
+    if (dev_io_read(dev, block, e->data) != 0) {
+        // no dejar en la cache un bloque con datos inválidos
+        lru_unlink(cache, e);
+        hash_unlink(cache, e);
+        cache->count--;
+        free(e);
+        return -1;
+    }
+
+    memcpy(buffer, e->data, BLOCK_SIZE);
+    return 0;
+}
+
+int cache_write_block(struct vfs_device *dev, uint32_t block, const void *buffer) {
+    // Escribe un bloque en la cache y lo marca sucio; llega a la imagen al desalojarlo o en cache_flush()
+    // Retorna 0 o -1 en caso de error
+    struct block_cache *cache = dev->cache;
+    struct cache_entry *e = cache_find(cache, block);
+
+    if (e) {
+        dev->stats.cache_hits++;
+        lru_unlink(cache, e);
+        lru_push_front(cache, e);
+    } else {
+        dev->stats.cache_misses++;
+        e = cache_get_entry(dev, block);
+        if (!e)
+            return -1;
+    }
+
+    memcpy(e->data, buffer, BLOCK_SIZE);
+    e->dirty = 1;
+    return 0;
+}
+
+int cache_peek(struct vfs_device *dev, uint32_t block, void *buffer) {
+    // Si el bloque está en la cache lo copia en buffer y retorna 1, si no retorna 0
+    // No modifica el orden LRU ni carga bloques: lo usan las lecturas de datos, que no pasan por la cache
+    struct cache_entry *e = cache_find(dev->cache, block);
+    if (!e)
+        return 0;
+
+    dev->stats.cache_hits++;
+    memcpy(buffer, e->data, BLOCK_SIZE);
+    return 1;
+}
+
+void cache_update(struct vfs_device *dev, uint32_t block, const void *buffer) {
+    // Si el bloque está en la cache reemplaza su contenido, que queda limpio:
+    // lo usan las escrituras de datos, que van directo a la imagen
+    struct cache_entry *e = cache_find(dev->cache, block);
+    if (!e)
+        return;
+
+    memcpy(e->data, buffer, BLOCK_SIZE);
+    e->dirty = 0;
+}
+
+static int compare_entry_blocks(const void *a, const void *b) {
+    const struct cache_entry *ea = *(const struct cache_entry *const *)a;
+    const struct cache_entry *eb = *(const struct cache_entry *const *)b;
+    return (ea->block > eb->block) - (ea->block < eb->block);
+}
+
+int cache_flush(struct vfs_device *dev) {
+    // Escribe a la imagen todos los bloques sucios, en orden de número de bloque
+    // Retorna 0 o -1 si alguna escritura falla (los bloques no escritos quedan sucios)
+    struct block_cache *cache = dev->cache;
+    if (!cache)
+        return 0;
+
+    uint32_t dirty_count = 0;
+    for (struct cache_entry *e = cache->head; e; e = e->next)
+        if (e->dirty)
+            dirty_count++;
+
+    if (dirty_count == 0)
+        return 0;
+
+    struct cache_entry **dirty = malloc(dirty_count * sizeof(struct cache_entry *));
+    if (!dirty)
+        return -1;
+
+    uint32_t n = 0;
+    for (struct cache_entry *e = cache->head; e; e = e->next)
+        if (e->dirty)
+            dirty[n++] = e;
+
+    qsort(dirty, n, sizeof(struct cache_entry *), compare_entry_blocks);
+
+    // Los bloques contiguos se escriben juntos, con un pwritev por corrida, y las corridas
+    // se envían por lotes con dev_io_submit()
+    int ret = 0;
+    struct iovec iov[VFS_MAX_IO_BLOCKS];
+    struct io_run runs[VFS_MAX_IO_BLOCKS];
+    uint32_t i = 0;
+    while (i < n) {
+        uint32_t first = i;
+        size_t nruns = 0;
+        int niov = 0;
+
+        while (i < n && niov < VFS_MAX_IO_BLOCKS) {
+            if (nruns == 0 || dirty[i]->block != runs[nruns - 1].block + runs[nruns - 1].iovcnt) {
+                runs[nruns].block = dirty[i]->block;
+                runs[nruns].iov = &iov[niov];
+                runs[nruns].iovcnt = 0;
+                nruns++;
+            }
+            iov[niov].iov_base = dirty[i]->data;
+            iov[niov].iov_len = BLOCK_SIZE;
+            runs[nruns - 1].iovcnt++;
+            niov++;
+            i++;
+        }
+
+        if (dev_io_submit(dev, 1, runs, nruns) != 0) {
+            fprintf(stderr, "Error al escribir los bloques %u a %u de la cache: %s\n", dirty[first]->block,
+                    dirty[i - 1]->block, strerror(errno));
+            ret = -1;
+            continue;
+        }
+
+        for (uint32_t j = first; j < i; j++)
+            dirty[j]->dirty = 0;
+        dev->stats.cache_writebacks += niov;
+    }
+
+    free(dirty);
+    return ret;
+}
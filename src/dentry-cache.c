@@ -0,0 +1,232 @@
+// dentry-cache.c
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vfs.h"
+
+/*
+    Cache de entradas del directorio raíz (dentry cache)
+    Guarda en memoria, por nombre, el nodo-I de cada entrada y dónde está: el bloque del
+    directorio y la posición de la entrada. Así un comando que recibe muchos nombres
+    (vfs-cat, vfs-rm, vfs-trunc, vfs-touch) no recorre el directorio una vez por nombre:
+        - en un directorio sin índice, la primera búsqueda que no está en la cache recorre el
+          directorio completo una sola vez y carga todas sus entradas; desde ahí la cache está
+          completa y un nombre que no está en ella no está en el directorio
+        - en un directorio con índice se guardan solo los nombres buscados, con una entrada
+          negativa (nodo-I en 0) para los que no están: buscar en el índice ya no recorre el
+          directorio, y cargarlo completo costaría más que las búsquedas
+        - dev_add_dir_entry y dev_remove_dir_entry la actualizan en el lugar: agregar un nombre
+          convierte su entrada negativa en positiva, y borrarlo la vuelve negativa
+    Es una tabla de hash con direccionamiento abierto (sondeo lineal) sobre dir_hash(). Como
+    las entradas borradas quedan negativas, nunca hace falta quitar una posición de la tabla.
+    Si falta memoria para crecer, la cache se vacía y se vuelve a buscar en el directorio.
+*/
+
+#define DCACHE_MIN_SIZE 64 // Posiciones iniciales de la tabla, potencia de 2
+
+struct dentry {
+    char name[FILENAME_MAX_LEN]; // Completado con ceros; vacío si la posición de la tabla está libre
+    uint32_t inode;              // 0 si es una entrada negativa: el nombre no está en el directorio
+    uint32_t block;              // Bloque del directorio con la entrada (en las positivas)
+    uint32_t slot;               // Posición de la entrada en el directorio (en las positivas)
+};
+
+struct dentry_cache {
+    struct dentry *table; // size posiciones, NULL hasta la primera entrada
+    uint32_t size;        // Potencia de 2
+    uint32_t used;        // Posiciones ocupadas, por entradas positivas o negativas
+    int complete;         // 1 si tiene todas las entradas del directorio
+};
+
+int dcache_init(struct vfs_device *dev, int enabled) {
+    // Crea la cache de entradas vacía. Retorna 0 o -1 en caso de error
+    dev->dcache = NULL;
+    if (!enabled)
+        return 0; // cache deshabilitada
+
+    dev->dcache = calloc(1, sizeof(struct dentry_cache));
+    return dev->dcache ? 0 : -1;
+}
+
+void dcache_reset(struct vfs_device *dev) {
+    // Descarta todas las entradas; se usa cuando el directorio raíz se vuelve a crear
+    struct dentry_cache *dcache = dev->dcache;
+    if (!dcache)
+        return;
+
+    free(dcache->table);
+    dcache->table = NULL;
+    dcache->size = 0;
+    dcache->used = 0;
+    dcache->complete = 0;
+}
+
+void dcache_free(struct vfs_device *dev) {
+    // Libera la cache
+    if (!dev->dcache)
+        return;
+
+    dcache_reset(dev);
+    free(dev->dcache);
+    dev->dcache = NULL;
+}
+
+static void dcache_key(char *key, const char *name) {
+    // Arma en key (FILENAME_MAX_LEN bytes) el nombre completado con ceros, como se guarda en la tabla
+    size_t len = strnlen(name, FILENAME_MAX_LEN);
+    memcpy(key, name, len);
+    memset(key + len, 0, FILENAME_MAX_LEN - len);
+}
+
+static struct dentry *dcache_find(struct dentry *table, uint32_t size, const char *key) {
+    // Posición de la tabla con el nombre key (completado con ceros), o la posición libre donde iría
+    uint32_t mask = size - 1;
+    for (uint32_t i = dir_hash(key) & mask;; i = (i + 1) & mask)
+        if (table[i].name[0] == '\0' || memcmp(table[i].name, key, FILENAME_MAX_LEN) == 0)
+            return &table[i];
+}
+
+static int dcache_grow(struct dentry_cache *dcache) {
+    // Duplica la tabla y reubica las entradas. Retorna 0 o -1 si no hay memoria
+    uint32_t size = dcache->size ? dcache->size * 2 : DCACHE_MIN_SIZE;
+    struct dentry *table = calloc(size, sizeof(struct dentry));
+    if (!table)
+        return -1;
+
+    for (uint32_t i = 0; i < dcache->size; i++)
+        if (dcache->table[i].name[0] != '\0')
+            *dcache_find(table, size, dcache->table[i].name) = dcache->table[i];
+
+    free(dcache->table);
+    dcache->table = table;
+    dcache->size = size;
+    return 0;
+}
+
+static int dcache_set(struct vfs_device *dev, const char *name, uint32_t inode_number, uint32_t block,
+                      uint32_t slot, int replace) {
+    // Guarda la entrada de name; si ya estaba, solo la reemplaza con replace en 1
+    // Retorna 0, o -1 si no hay memoria (la cache queda vacía)
+    struct dentry_cache *dcache = dev->dcache;
+    char key[FILENAME_MAX_LEN];
+    dcache_key(key, name);
+
+    // Se mantiene la tabla a lo sumo 3/4 llena, así el sondeo encuentra una posición libre enseguida
+    if ((dcache->used + 1) * 4 > dcache->size * 3 && dcache_grow(dcache) != 0) {
+        dcache_reset(dev);
+        return -1;
+    }
+
+    struct dentry *d = dcache_find(dcache->table, dcache->size, key);
+    if (d->name[0] == '\0') {
+        memcpy(d->name, key, FILENAME_MAX_LEN);
+        dcache->used++;
+    } else if (!replace) {
+        return 0;
+    }
+
+    d->inode = inode_number;
+    d->block = block;
+    d->slot = slot;
+    return 0;
+}
+
+int dcache_lookup(struct vfs_device *dev, const char *name, uint32_t *inode_number, uint32_t *block,
+                  uint32_t *slot) {
+    // Busca name en la cache. Si está, deja su nodo-I en *inode_number (0 si es una entrada negativa o
+    // si la cache está completa y no lo tiene) y, si existe, su bloque y posición en *block y *slot
+    // Retorna 1 si la cache sabe la respuesta, o 0 si hay que buscar en el directorio
+    struct dentry_cache *dcache = dev->dcache;
+    if (!dcache)
+        return 0;
+
+    struct dentry *d = NULL;
+    if (dcache->table) {
+        char key[FILENAME_MAX_LEN];
+        dcache_key(key, name);
+        d = dcache_find(dcache->table, dcache->size, key);
+        if (d->name[0] == '\0')
+            d = NULL;
+    }
+
+    if (d && d->inode != 0) {
+        dev->stats.dcache_hits++;
+        *inode_number = d->inode;
+        *block = d->block;
+        *slot = d->slot;
+        return 1;
+    }
+    if (d || dcache->complete) {
+        dev->stats.dcache_negative++;
+        *inode_number = 0;
+        return 1;
+    }
+
+    dev->stats.dcache_misses++;
+    return 0;
+}
+
+void dcache_update(struct vfs_device *dev, const char *name, uint32_t inode_number, uint32_t block,
+                   uint32_t slot) {
+    // Registra que name está en el directorio con el nodo-I inode_number, en el bloque block y la
+    // posición slot, o con inode_number en 0 que no está (entrada negativa)
+    if (dev->dcache)
+        dcache_set(dev, name, inode_number, block, slot, 1);
+}
+
+int dcache_fill(struct vfs_device *dev, const struct inode *root) {
+    // Recorre el directorio raíz completo y carga todas sus entradas; la cache queda completa
+    // Si falta memoria la cache queda vacía y no es un error. Retorna 0 o -1 si falla una lectura
+    struct dentry_cache *dcache = dev->dcache;
+    if (!dcache)
+        return 0;
+
+    dev->stats.dcache_scans++;
+
+    struct bmap_cursor cur;
+    bmap_cursor_init(&cur, root, 0);
+    uint32_t start, count;
+    int r;
+    while ((r = dev_bmap_next(dev, &cur, UINT32_MAX, &start, &count)) == 1) {
+        if (start == 0)
+            continue; // un hueco no tiene entradas: dev_read_block leería el superbloque
+
+        uint32_t logical = cur.index - count;
+        for (uint32_t block_num = start; block_num < start + count; block_num++) {
+            uint8_t data_buf[BLOCK_SIZE];
+            if (dev_read_block(dev, block_num, data_buf) != 0) {
+                fprintf(stderr, "Error al leer el bloque %u: %s\n", block_num, strerror(errno));
+                dcache_reset(dev);
+                return -1;
+            }
+
+            const struct dir_entry *entries = (const struct dir_entry *)data_buf;
+            uint32_t match, free_mask;
+            dir_block_scan(entries, NULL, &match, &free_mask);
+
+            // Si un nombre se repite vale la primera entrada, como al recorrer el directorio
+            for (uint32_t in_use = ~free_mask; in_use != 0; in_use &= in_use - 1) {
+                uint32_t j = (uint32_t)__builtin_ctz(in_use);
+                uint32_t slot = (logical + block_num - start) * DIR_ENTRIES_PER_BLOCK + j;
+                char name[FILENAME_MAX_LEN + 1] = {0};
+                memcpy(name, entries[j].name, FILENAME_MAX_LEN);
+                if (name[0] != '\0' && dcache_set(dev, name, entries[j].inode, block_num, slot, 0) != 0)
+                    return 0;
+            }
+        }
+    }
+
+    if (r < 0) {
+        fprintf(stderr, "Error inesperado el buscar bloque %u del directorio raiz.\n", cur.index);
+        dcache_reset(dev);
+        return -1;
+    }
+
+    DEBUG_PRINT("Cache de entradas cargada: %u nombres.\n", dcache->used);
+    dcache->complete = 1;
+    return 0;
+}
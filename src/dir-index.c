@@ -0,0 +1,266 @@
+// dir-index.c
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "vfs.h"
+
+/*
+    Índice de hash de un directorio (VFS_FEATURE_DIR_INDEX, nodo-I con INODE_MODE_INDEXED)
+    Las entradas siguen en los bloques del directorio con el formato lineal de siempre, así un
+    programa que no conoce el índice puede leer el directorio. El índice está en bloques aparte,
+    fuera del mapa de bloques del directorio, y el nodo-I guarda su raíz en dir_index:
+        - la raíz (struct dir_index_root) tiene 2^depth punteros a baldes, elegidos con los
+          depth bits más bajos del hash del nombre (hashing extensible)
+        - cada balde (struct dir_index_bucket) guarda pares (hash, posición de la entrada)
+        - un balde lleno se divide en dos según el siguiente bit del hash, duplicando la raíz si
+          hace falta; con DIR_INDEX_MAX_DEPTH bits ya no se divide y se le encadena un desborde
+    Buscar, agregar o borrar un nombre lee la raíz, un balde y, para comparar el nombre, el
+    bloque del directorio que tiene la entrada.
+    El índice se actualiza en dev_add_dir_entry y dev_remove_dir_entry: si un programa que no lo
+    conoce agrega o borra entradas, el índice queda desactualizado.
+*/
+
+uint32_t dir_hash(const char *name) {
+    // Hash FNV-1a de un nombre de hasta FILENAME_MAX_LEN caracteres
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < FILENAME_MAX_LEN && name[i] != '\0'; i++) {
+        h ^= (uint8_t)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int index_read_root(struct vfs_device *dev, const struct inode *dir, struct dir_index_root *root) {
+    // Lee la raíz del índice de dir. Retorna 0 o -1
+    if (dir->dir_index == 0 || dev_read_block(dev, dir->dir_index, root) != 0) {
+        fprintf(stderr, "Error al leer la raíz del índice del directorio (bloque %u)\n", dir->dir_index);
+        return -1;
+    }
+    if (root->depth > DIR_INDEX_MAX_DEPTH) {
+        fprintf(stderr, "Error: índice de directorio inválido (profundidad %u)\n", root->depth);
+        return -1;
+    }
+    return 0;
+}
+
+static uint32_t index_bucket_of(const struct dir_index_root *root, uint32_t hash) {
+    // Bloque del balde que corresponde a hash
+    return root->buckets[hash & ((1u << root->depth) - 1)];
+}
+
+static int index_new_bucket(struct vfs_device *dev, uint16_t depth, struct dir_index_bucket *bucket) {
+    // Reserva un bloque para un balde vacío de profundidad depth, que queda en *bucket sin escribir
+    // Retorna el número de bloque, o -1 en caso de error
+    int block = dev_bitmap_set_first_free(dev);
+    if (block < 0) {
+        fprintf(stderr, "Error: no hay bloques libres para el índice del directorio\n");
+        return -1;
+    }
+    memset(bucket, 0, sizeof(*bucket));
+    bucket->depth = depth;
+    return block;
+}
+
+int dev_dir_index_create(struct vfs_device *dev, struct inode *dir) {
+    // Crea un índice vacío para dir: la raíz y un único balde
+    // Marca el nodo-I con INODE_MODE_INDEXED; es responsabilidad del llamador escribirlo. Retorna 0 o -1
+    struct dir_index_root root_struct = {0}, *root = &root_struct;
+
+    int root_block = dev_bitmap_set_first_free(dev);
+    if (root_block < 0) {
+        fprintf(stderr, "Error: no hay bloques libres para el índice del directorio\n");
+        return -1;
+    }
+
+    struct dir_index_bucket bucket;
+    int bucket_block = index_new_bucket(dev, 0, &bucket);
+    if (bucket_block < 0)
+        return -1;
+
+    root->depth = 0;
+    root->buckets[0] = (uint32_t)bucket_block;
+
+    struct block_io ios[2] = {{(uint32_t)root_block, root}, {(uint32_t)bucket_block, &bucket}};
+    if (dev_write_blocks(dev, ios, 2) != 0) {
+        fprintf(stderr, "Error al escribir el índice del directorio\n");
+        return -1;
+    }
+
+    dir->dir_index = (uint32_t)root_block;
+    dir->mode |= INODE_MODE_INDEXED;
+    return 0;
+}
+
+int dev_dir_index_lookup(struct vfs_device *dev, struct inode *dir, const char *name, uint32_t *slot) {
+    // Busca name con el índice de dir y deja en *slot (si no es NULL) la posición de su entrada
+    // Retorna el nodo-I de la entrada, 0 si no está, o -1 en caso de error
+    struct dir_index_root root;
+    if (index_read_root(dev, dir, &root) != 0)
+        return -1;
+
+    uint32_t hash = dir_hash(name);
+    uint32_t dir_block = 0; // bloque del directorio cargado en entries
+    uint8_t data_buf[BLOCK_SIZE];
+    struct dir_entry *entries = (struct dir_entry *)data_buf;
+
+    struct dir_index_bucket bucket;
+    for (uint32_t b = index_bucket_of(&root, hash); b != 0; b = bucket.next) {
+        if (dev_read_block(dev, b, &bucket) != 0 || bucket.count > NUM_DIR_INDEX_ENTRIES) {
+            fprintf(stderr, "Error al leer el balde %u del índice del directorio\n", b);
+            return -1;
+        }
+
+        for (uint32_t i = 0; i < bucket.count; i++) {
+            if (bucket.ent[i].hash != hash)
+                continue;
+
+            // Mismo hash: se compara el nombre en la entrada del directorio
+            uint32_t s = bucket.ent[i].slot;
+            if (s / DIR_ENTRIES_PER_BLOCK >= dir->blocks) {
+                fprintf(stderr, "Error: el índice del directorio apunta fuera del directorio (%u)\n", s);
+                return -1;
+            }
+            int block = dev_get_block_number_at(dev, dir, (uint16_t)(s / DIR_ENTRIES_PER_BLOCK));
+            if (block <= 0)
+                return -1;
+            if ((uint32_t)block != dir_block) {
+                if (dev_read_block(dev, block, data_buf) != 0)
+                    return -1;
+                dir_block = (uint32_t)block;
+            }
+
+            const struct dir_entry *e = &entries[s % DIR_ENTRIES_PER_BLOCK];
+            if (e->inode != 0 && strncmp(e->name, name, FILENAME_MAX_LEN) == 0) {
+                if (slot)
+                    *slot = s;
+                return (int)e->inode;
+            }
+        }
+    }
+
+    return 0; // No encontrado
+}
+
+static int index_split(struct vfs_device *dev, struct dir_index_root *root, uint32_t root_block, uint32_t block,
+                       struct dir_index_bucket *bucket) {
+    // Divide el balde lleno *bucket (bloque block) según el bit depth del hash; si el balde ya usa
+    // todos los bits de la raíz, primero se duplica la raíz. Escribe los dos baldes y la raíz
+    // Retorna 0 o -1
+    if (bucket->depth == root->depth) {
+        uint32_t n = 1u << root->depth;
+        memcpy(&root->buckets[n], &root->buckets[0], n * sizeof(uint32_t));
+        root->depth++;
+    }
+
+    struct dir_index_bucket sibling;
+    int sibling_block = index_new_bucket(dev, bucket->depth + 1, &sibling);
+    if (sibling_block < 0)
+        return -1;
+
+    // Las entradas con el bit en 1 pasan al balde nuevo
+    uint32_t bit = 1u << bucket->depth;
+    uint16_t kept = 0;
+    for (uint32_t i = 0; i < bucket->count; i++) {
+        if (bucket->ent[i].hash & bit)
+            sibling.ent[sibling.count++] = bucket->ent[i];
+        else
+            bucket->ent[kept++] = bucket->ent[i];
+    }
+    bucket->count = kept;
+    bucket->depth++;
+
+    for (uint32_t i = 0; i < (1u << root->depth); i++)
+        if (root->buckets[i] == block && (i & bit))
+            root->buckets[i] = (uint32_t)sibling_block;
+
+    DEBUG_PRINT("Balde %u del índice dividido: %u entradas quedan, %u pasan al %d.\n", block, kept, sibling.count,
+                sibling_block);
+
+    struct block_io ios[3] = {{block, bucket}, {(uint32_t)sibling_block, &sibling}, {root_block, root}};
+    if (dev_write_blocks(dev, ios, 3) != 0) {
+        fprintf(stderr, "Error al escribir el índice del directorio\n");
+        return -1;
+    }
+    return 0;
+}
+
+int dev_dir_index_insert(struct vfs_device *dev, struct inode *dir, const char *name, uint32_t slot) {
+    // Agrega al índice de dir el nombre name, cuya entrada está en la posición slot del directorio
+    // Retorna 0 o -1
+    struct dir_index_root root;
+    if (index_read_root(dev, dir, &root) != 0)
+        return -1;
+
+    uint32_t hash = dir_hash(name);
+    struct dir_index_bucket bucket;
+    uint32_t block = index_bucket_of(&root, hash);
+    if (dev_read_block(dev, block, &bucket) != 0)
+        return -1;
+
+    // Mientras el balde esté lleno y se pueda, se divide
+    while (bucket.count == NUM_DIR_INDEX_ENTRIES && bucket.depth < DIR_INDEX_MAX_DEPTH) {
+        if (index_split(dev, &root, dir->dir_index, block, &bucket) != 0)
+            return -1;
+        block = index_bucket_of(&root, hash);
+        if (dev_read_block(dev, block, &bucket) != 0)
+            return -1;
+    }
+
+    // Con todos los bits en uso, se sigue por la cadena de desborde hasta un balde con lugar
+    while (bucket.count == NUM_DIR_INDEX_ENTRIES) {
+        if (bucket.next == 0) {
+            struct dir_index_bucket overflow;
+            int overflow_block = index_new_bucket(dev, bucket.depth, &overflow);
+            if (overflow_block < 0)
+                return -1;
+            bucket.next = (uint32_t)overflow_block;
+            if (dev_write_block(dev, block, &bucket) != 0)
+                return -1;
+            block = (uint32_t)overflow_block;
+            bucket = overflow;
+            break;
+        }
+        block = bucket.next;
+        if (dev_read_block(dev, block, &bucket) != 0)
+            return -1;
+    }
+
+    bucket.ent[bucket.count].hash = hash;
+    bucket.ent[bucket.count].slot = slot;
+    bucket.count++;
+    if (dev_write_block(dev, block, &bucket) != 0) {
+        fprintf(stderr, "Error al escribir el balde %u del índice del directorio\n", block);
+        return -1;
+    }
+    return 0;
+}
+
+int dev_dir_index_remove(struct vfs_device *dev, struct inode *dir, const char *name, uint32_t slot) {
+    // Quita del índice de dir la entrada de name en la posición slot; la última del balde ocupa su lugar
+    // Retorna 0 (también si no estaba) o -1
+    struct dir_index_root root;
+    if (index_read_root(dev, dir, &root) != 0)
+        return -1;
+
+    uint32_t hash = dir_hash(name);
+    struct dir_index_bucket bucket;
+    for (uint32_t b = index_bucket_of(&root, hash); b != 0; b = bucket.next) {
+        if (dev_read_block(dev, b, &bucket) != 0 || bucket.count > NUM_DIR_INDEX_ENTRIES)
+            return -1;
+
+        for (uint32_t i = 0; i < bucket.count; i++) {
+            if (bucket.ent[i].hash != hash || bucket.ent[i].slot != slot)
+                continue;
+
+            bucket.ent[i] = bucket.ent[bucket.count - 1];
+            bucket.count--;
+            return dev_write_block(dev, b, &bucket);
+        }
+    }
+
+    DEBUG_PRINT("La entrada %u (%s) no estaba en el índice del directorio\n", slot, name);
+    return 0;
+}
@@ -0,0 +1,156 @@
+// dir-scan.c
+
+#include "vfs.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VFS_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/*
+    Recorrido de un bloque de directorio completo
+
+    Cada entrada es un registro fijo de 32 bytes: 4 del nodo-I y 28 del nombre, completado
+    con ceros (las entradas se escriben con strncpy y se borran con memset). Así buscar un
+    nombre es comparar los 28 bytes del nombre contra una clave armada de la misma forma,
+    sin recorrer el nombre byte a byte como strncmp.
+
+    dir_block_scan() recorre las DIR_ENTRIES_PER_BLOCK entradas de un bloque y devuelve dos
+    máscaras de bits: las entradas en uso cuyo nombre coincide con la clave, y las libres
+    (nodo-I en 0). Con AVX2 compara una entrada por instrucción, con SSE2 en dos mitades.
+    La variante se elige en tiempo de ejecución según el procesador, y se puede forzar con
+    la variable de entorno VFS_DIR_SCAN=scalar|sse2|avx2.
+*/
+
+#define INODE_MASK 0x0000000Fu // bytes del nodo-I en la máscara de comparación de una entrada
+
+typedef void (*dir_scan_fn)(const struct dir_entry *entries, const struct dir_entry *key, uint32_t *match,
+                            uint32_t *free_mask);
+
+static void dir_scan_scalar(const struct dir_entry *entries, const struct dir_entry *key, uint32_t *match,
+                            uint32_t *free_mask) {
+    uint32_t m = 0, f = 0, bit = 1;
+    for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++, bit <<= 1) {
+        if (entries[j].inode == 0)
+            f |= bit;
+        else if (memcmp(entries[j].name, key->name, FILENAME_MAX_LEN) == 0)
+            m |= bit;
+    }
+    *match = m;
+    *free_mask = f;
+}
+
+#ifdef VFS_HAVE_X86_SIMD
+__attribute__((target("sse2"))) static void dir_scan_sse2(const struct dir_entry *entries, const struct dir_entry *key,
+                                                          uint32_t *match, uint32_t *free_mask) {
+    const __m128i k0 = _mm_loadu_si128((const __m128i *)key);
+    const __m128i k1 = _mm_loadu_si128((const __m128i *)key + 1);
+    uint32_t m = 0, f = 0, bit = 1;
+    for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++, bit <<= 1) {
+        if (entries[j].inode == 0) {
+            f |= bit;
+            continue;
+        }
+        __m128i v0 = _mm_loadu_si128((const __m128i *)&entries[j]);
+        __m128i v1 = _mm_loadu_si128((const __m128i *)&entries[j] + 1);
+        uint32_t eq = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v0, k0)) |
+                      (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v1, k1)) << 16;
+        if ((eq | INODE_MASK) == 0xFFFFFFFFu)
+            m |= bit;
+    }
+    *match = m;
+    *free_mask = f;
+}
+
+__attribute__((target("avx2"))) static void dir_scan_avx2(const struct dir_entry *entries, const struct dir_entry *key,
+                                                          uint32_t *match, uint32_t *free_mask) {
+    const __m256i k = _mm256_loadu_si256((const __m256i *)key);
+    uint32_t m = 0, f = 0, bit = 1;
+    for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++, bit <<= 1) {
+        if (entries[j].inode == 0) {
+            f |= bit;
+            continue;
+        }
+        __m256i v = _mm256_loadu_si256((const __m256i *)&entries[j]);
+        uint32_t eq = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, k));
+        if ((eq | INODE_MASK) == 0xFFFFFFFFu)
+            m |= bit;
+    }
+    *match = m;
+    *free_mask = f;
+}
+#endif
+
+static dir_scan_fn dir_scan = NULL;
+static const char *dir_scan_variant = NULL;
+
+int dir_scan_select(const char *name) {
+    // Elige la variante del recorrido: "scalar", "sse2", "avx2", o NULL para la mejor disponible
+    // Retorna 0, o -1 si la variante pedida no está disponible (se deja la escalar)
+    dir_scan = dir_scan_scalar;
+    dir_scan_variant = "scalar";
+
+#ifdef VFS_HAVE_X86_SIMD
+    __builtin_cpu_init();
+    int have_sse2 = __builtin_cpu_supports("sse2");
+    int have_avx2 = __builtin_cpu_supports("avx2");
+
+    if ((name == NULL || strcmp(name, "avx2") == 0) && have_avx2) {
+        dir_scan = dir_scan_avx2;
+        dir_scan_variant = "avx2";
+        return 0;
+    }
+    if ((name == NULL || strcmp(name, "sse2") == 0) && have_sse2) {
+        dir_scan = dir_scan_sse2;
+        dir_scan_variant = "sse2";
+        return 0;
+    }
+#endif
+
+    if (name == NULL || strcmp(name, "scalar") == 0)
+        return 0;
+    return -1;
+}
+
+static void dir_scan_init(void) {
+    // Primer recorrido: variante pedida en VFS_DIR_SCAN, o la mejor disponible
+    const char *name = getenv(VFS_ENV_DIR_SCAN);
+    if (name && *name == '\0')
+        name = NULL;
+
+    if (dir_scan_select(name) != 0) {
+        fprintf(stderr, "Advertencia: %s=%s no disponible, se usa la mejor variante\n", VFS_ENV_DIR_SCAN, name);
+        dir_scan_select(NULL);
+    }
+}
+
+const char *dir_scan_name(void) {
+    // Nombre de la variante del recorrido en uso
+    if (!dir_scan)
+        dir_scan_init();
+    return dir_scan_variant;
+}
+
+void dir_key_init(struct dir_entry *key, const char *name) {
+    // Arma la clave de búsqueda de name: una entrada con el nombre completado con ceros
+    memset(key, 0, sizeof(*key));
+    memcpy(key->name, name, strnlen(name, FILENAME_MAX_LEN));
+}
+
+void dir_block_scan(const struct dir_entry *entries, const struct dir_entry *key, uint32_t *match,
+                    uint32_t *free_mask) {
+    // Recorre las DIR_ENTRIES_PER_BLOCK entradas de un bloque de directorio. El bit j de *match queda
+    // en 1 si la entrada j está en uso y su nombre es el de key (ver dir_key_init); el de *free_mask,
+    // si la entrada j está libre. key puede ser NULL si solo interesan las libres
+    if (!dir_scan)
+        dir_scan_init();
+
+    static const struct dir_entry no_key; // nombre vacío: ninguna entrada en uso coincide
+    uint32_t m;
+    dir_scan(entries, key ? key : &no_key, &m, free_mask);
+    *match = key ? m : 0;
+}
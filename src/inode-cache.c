@@ -0,0 +1,320 @@
+// inode-cache.c
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vfs.h"
+
+/*
+    Cache de nodos-I con escritura diferida (write-back)
+    Se ubica entre dev_read_inode/dev_write_inode y la tabla de nodos-I de la imagen:
+        - los nodos-I se guardan por bloque de la tabla: el primer acceso a un nodo-I
+          carga el bloque completo, con sus INODES_PER_BLOCK nodos-I
+        - una lectura de un nodo-I ya cargado es un memcpy, sin releer el superbloque
+        - una escritura solo modifica la copia en memoria y marca sucio su bloque
+        - los bloques sucios se escriben juntos con dev_write_blocks() en vfs_flush()
+    Los bloques de la tabla se buscan por índice en un arreglo, y se reservan a medida
+    que se usan: la memoria nunca supera el tamaño de la tabla de la imagen.
+
+    Los bloques de la tabla se leen con dev_read_blocks(), así varios bloques faltantes
+    (dev_read_inodes, dev_inode_prefetch) se leen en un solo lote y no ocupan lugar en
+    la cache de bloques. Mientras la cache de nodos-I está habilitada, todo acceso a la
+    tabla debe pasar por ella.
+*/
+
+struct icache_block {
+    int dirty;                              // 1 si algún nodo-I difiere de la imagen
+    struct inode inodes[INODES_PER_BLOCK];
+};
+
+struct inode_cache {
+    uint32_t inode_start;           // Copia de sb->inode_start
+    uint32_t inode_count;           // Copia de sb->inode_count, 0 si todavía no se leyó el superbloque
+    uint32_t inode_blocks;          // Cantidad de bloques de la tabla
+    struct icache_block **blocks;   // Bloque i de la tabla, NULL si no está cargado
+};
+
+int icache_init(struct vfs_device *dev, int enabled) {
+    // Crea la cache de nodos-I vacía; la geometría se lee del superbloque en el primer uso
+    // Retorna 0 o -1 en caso de error
+    dev->icache = NULL;
+    if (!enabled)
+        return 0; // cache deshabilitada
+
+    dev->icache = calloc(1, sizeof(struct inode_cache));
+    return dev->icache ? 0 : -1;
+}
+
+void icache_reset(struct vfs_device *dev) {
+    // Descarta todos los nodos-I cargados, sin escribir los sucios; ver icache_flush()
+    // Se usa también cuando cambia la geometría de la imagen (dev_init_superblock)
+    struct inode_cache *icache = dev->icache;
+    if (!icache)
+        return;
+
+    for (uint32_t i = 0; i < icache->inode_blocks; i++)
+        free(icache->blocks[i]);
+    free(icache->blocks);
+
+    icache->blocks = NULL;
+    icache->inode_count = 0;
+    icache->inode_blocks = 0;
+}
+
+void icache_free(struct vfs_device *dev) {
+    // Libera la cache sin escribir los nodos-I sucios
+    if (!dev->icache)
+        return;
+
+    icache_reset(dev);
+    free(dev->icache);
+    dev->icache = NULL;
+}
+
+static int icache_setup(struct vfs_device *dev) {
+    // Lee la geometría de la tabla de nodos-I del superbloque, si todavía no se hizo
+    // Retorna 0 o -1 en caso de error
+    struct inode_cache *icache = dev->icache;
+    if (icache->inode_count != 0)
+        return 0;
+
+    struct superblock sb_struct, *sb = &sb_struct;
+    if (dev_read_superblock(dev, sb) != 0)
+        return -1;
+
+    icache->blocks = calloc(sb->inode_blocks, sizeof(struct icache_block *));
+    if (!icache->blocks)
+        return -1;
+
+    icache->inode_start = sb->inode_start;
+    icache->inode_count = sb->inode_count;
+    icache->inode_blocks = sb->inode_blocks;
+    return 0;
+}
+
+static int compare_uint32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int icache_load(struct vfs_device *dev, uint32_t *table_blocks, size_t count) {
+    // Carga los bloques de la tabla indicados (índices dentro de la tabla) que no estén en la cache
+    // Los faltantes se leen juntos con dev_read_blocks(), en orden de número de bloque
+    // Retorna 0 o -1 en caso de error
+    struct inode_cache *icache = dev->icache;
+
+    qsort(table_blocks, count, sizeof(uint32_t), compare_uint32);
+
+    struct block_io *ios = malloc(count * sizeof(struct block_io));
+    struct icache_block **loaded = malloc(count * sizeof(struct icache_block *));
+    if (!ios || !loaded) {
+        free(ios);
+        free(loaded);
+        return -1;
+    }
+
+    size_t n = 0;
+    int ret = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t t = table_blocks[i];
+        if (icache->blocks[t] || (i > 0 && table_blocks[i - 1] == t))
+            continue; // ya cargado o repetido
+
+        loaded[n] = malloc(sizeof(struct icache_block));
+        if (!loaded[n]) {
+            ret = -1;
+            break;
+        }
+        loaded[n]->dirty = 0;
+        ios[n].block = icache->inode_start + t;
+        ios[n].buffer = loaded[n]->inodes;
+        n++;
+    }
+
+    if (ret == 0 && n > 0 && dev_read_blocks(dev, ios, n) != 0)
+        ret = -1;
+
+    for (size_t i = 0; i < n; i++) {
+        if (ret != 0) {
+            free(loaded[i]); // no dejar en la cache bloques con datos inválidos
+            continue;
+        }
+        icache->blocks[ios[i].block - icache->inode_start] = loaded[i];
+        dev->stats.icache_loads++;
+    }
+
+    free(ios);
+    free(loaded);
+    return ret;
+}
+
+static struct icache_block *icache_get(struct vfs_device *dev, uint32_t inode_number) {
+    // Bloque de la tabla que contiene inode_number, cargándolo si hace falta; NULL en caso de error
+    struct inode_cache *icache = dev->icache;
+    uint32_t t = inode_number / INODES_PER_BLOCK;
+
+    if (icache->blocks[t]) {
+        dev->stats.icache_hits++;
+        return icache->blocks[t];
+    }
+
+    dev->stats.icache_misses++;
+    if (icache_load(dev, &t, 1) != 0)
+        return NULL;
+    return icache->blocks[t];
+}
+
+static int icache_check(struct vfs_device *dev, uint32_t inode_number, const char *func) {
+    // Verifica que inode_number sea un nodo-I válido de la imagen. Retorna 0 o -1
+    if (icache_setup(dev) != 0)
+        return -1;
+
+    if (inode_number < ROOTDIR_INODE || inode_number >= dev->icache->inode_count) {
+        fprintf(stderr, "Error en %s: nro nodo-I inválido (%d)\n", func, inode_number);
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int icache_read(struct vfs_device *dev, uint32_t inode_number, struct inode *in) {
+    // Lee un nodo-I a través de la cache. Retorna 0 o -1 en caso de error
+    if (icache_check(dev, inode_number, "read_inode") != 0)
+        return -1;
+
+    struct icache_block *b = icache_get(dev, inode_number);
+    if (!b)
+        return -1;
+
+    *in = b->inodes[inode_number % INODES_PER_BLOCK];
+    return 0;
+}
+
+int icache_write(struct vfs_device *dev, uint32_t inode_number, const struct inode *in) {
+    // Escribe un nodo-I en la cache y marca sucio su bloque; llega a la imagen en icache_flush()
+    // Retorna 0 o -1 en caso de error
+    if (dev->mode != VFS_OPEN_RDWR) {
+        errno = EBADF;
+        return -1;
+    }
+
+    if (icache_check(dev, inode_number, "write_inode") != 0)
+        return -1;
+
+    struct icache_block *b = icache_get(dev, inode_number);
+    if (!b)
+        return -1;
+
+    b->inodes[inode_number % INODES_PER_BLOCK] = *in;
+    b->dirty = 1;
+    return 0;
+}
+
+int icache_read_range(struct vfs_device *dev, uint32_t first, uint32_t count, struct inode *out) {
+    // Copia en out los nodos-I first a first + count - 1, cargando juntos los bloques que falten
+    // Retorna 0 o -1 en caso de error
+    if (icache_setup(dev) != 0)
+        return -1;
+
+    struct inode_cache *icache = dev->icache;
+    if (count == 0)
+        return 0;
+    if (first >= icache->inode_count || count > icache->inode_count - first) {
+        fprintf(stderr, "Error en read_inodes: rango de nodos-I inválido (%u, %u)\n", first, count);
+        errno = EINVAL;
+        return -1;
+    }
+
+    uint32_t first_block = first / INODES_PER_BLOCK;
+    uint32_t last_block = (first + count - 1) / INODES_PER_BLOCK;
+    uint32_t nblocks = last_block - first_block + 1;
+
+    uint32_t *table_blocks = malloc(nblocks * sizeof(uint32_t));
+    if (!table_blocks)
+        return -1;
+    for (uint32_t i = 0; i < nblocks; i++)
+        table_blocks[i] = first_block + i;
+
+    int ret = icache_load(dev, table_blocks, nblocks);
+    free(table_blocks);
+    if (ret != 0)
+        return -1;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t inode_number = first + i;
+        out[i] = icache->blocks[inode_number / INODES_PER_BLOCK]->inodes[inode_number % INODES_PER_BLOCK];
+    }
+    return 0;
+}
+
+int icache_prefetch(struct vfs_device *dev, const uint32_t *inode_numbers, size_t count) {
+    // Carga juntos los bloques de la tabla que contienen los nodos-I indicados
+    // Los números fuera de rango se ignoran: los informa la lectura posterior
+    // Retorna 0 o -1 en caso de error
+    if (icache_setup(dev) != 0)
+        return -1;
+
+    struct inode_cache *icache = dev->icache;
+    uint32_t *table_blocks = malloc((count > 0 ? count : 1) * sizeof(uint32_t));
+    if (!table_blocks)
+        return -1;
+
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (inode_numbers[i] >= icache->inode_count)
+            continue;
+        uint32_t t = inode_numbers[i] / INODES_PER_BLOCK;
+        if (!icache->blocks[t])
+            table_blocks[n++] = t;
+    }
+
+    int ret = icache_load(dev, table_blocks, n);
+    free(table_blocks);
+    return ret;
+}
+
+int icache_flush(struct vfs_device *dev) {
+    // Escribe a la imagen los bloques de la tabla con nodos-I sucios, en un solo lote
+    // Retorna 0 o -1 si la escritura falla (los bloques quedan sucios)
+    struct inode_cache *icache = dev->icache;
+    if (!icache)
+        return 0;
+
+    uint32_t dirty_count = 0;
+    for (uint32_t i = 0; i < icache->inode_blocks; i++)
+        if (icache->blocks[i] && icache->blocks[i]->dirty)
+            dirty_count++;
+
+    if (dirty_count == 0)
+        return 0;
+
+    struct block_io *ios = malloc(dirty_count * sizeof(struct block_io));
+    if (!ios)
+        return -1;
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < icache->inode_blocks; i++) {
+        if (icache->blocks[i] && icache->blocks[i]->dirty) {
+            ios[n].block = icache->inode_start + i;
+            ios[n].buffer = icache->blocks[i]->inodes;
+            n++;
+        }
+    }
+
+    int ret = dev_write_blocks(dev, ios, n);
+    if (ret != 0) {
+        fprintf(stderr, "Error al escribir la tabla de nodos-I: %s\n", strerror(errno));
+    } else {
+        for (uint32_t i = 0; i < icache->inode_blocks; i++)
+            if (icache->blocks[i])
+                icache->blocks[i]->dirty = 0;
+        dev->stats.icache_writebacks += n;
+    }
+
+    free(ios);
+    return ret;
+}
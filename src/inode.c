@@ -4,21 +4,25 @@
 #include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "vfs.h"
 
-int read_inode(const char *image_path, uint32_t inode_number, struct inode *in) {
+int dev_read_inode(struct vfs_device *dev, uint32_t inode_number, struct inode *in) {
     // Lee nodo-I de la posicion inode_number
     // lo retorna en la estructura apuntada por *in
     // Retorna 0 o -1 si encuentra un error
 
+    if (dev->icache)
+        return icache_read(dev, inode_number, in);
+
     struct superblock sb_struct, *sb = &sb_struct;
 
     // Leer el superbloque
-    if (read_superblock(image_path, sb) != 0) {
+    if (dev_read_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error al leer superblock\n");
         return -1;
     }
@@ -33,7 +37,7 @@ int read_inode(const char *image_path, uint32_t inode_number, struct inode *in)
 
     // Leer el bloque de inodos correspondiente
     uint8_t inode_block_buffer[BLOCK_SIZE];
-    if (read_block(image_path, sb->inode_start + block_index, inode_block_buffer) != 0)
+    if (dev_read_block(dev, sb->inode_start + block_index, inode_block_buffer) != 0)
         return -1;
 
     // Obtener el puntero al inodo dentro del bloque
@@ -43,14 +47,17 @@ int read_inode(const char *image_path, uint32_t inode_number, struct inode *in)
     return 0;
 }
 
-int write_inode(const char *image_path, uint32_t inode_number, const struct inode *in) {
+int dev_write_inode(struct vfs_device *dev, uint32_t inode_number, const struct inode *in) {
     struct superblock sb_struct, *sb = &sb_struct;
     // Escribe nodo-I de la posicion inode_number
     // lo lee de la estructura apuntada por *in
     // Retorna 0 o -1 si encuentra un error
 
+    if (dev->icache)
+        return icache_write(dev, inode_number, in);
+
     // Leer el superbloque
-    if (read_superblock(image_path, sb) != 0) {
+    if (dev_read_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error al leer superblock\n");
         return -1;
     }
@@ -65,7 +72,7 @@ int write_inode(const char *image_path, uint32_t inode_number, const struct inod
 
     // Leer el bloque de inodos correspondiente
     uint8_t inode_block_buffer[BLOCK_SIZE];
-    if (read_block(image_path, sb->inode_start + block_index, inode_block_buffer) != 0)
+    if (dev_read_block(dev, sb->inode_start + block_index, inode_block_buffer) != 0)
         return -1;
 
     // Modificar el inodo en memoria
@@ -73,7 +80,7 @@ int write_inode(const char *image_path, uint32_t inode_number, const struct inod
     inodes[block_offset] = *in;
 
     // Escribir el bloque modificado en disco
-    if (write_block(image_path, sb->inode_start + block_index, inode_block_buffer) != 0)
+    if (dev_write_block(dev, sb->inode_start + block_index, inode_block_buffer) != 0)
         return -1;
 
     DEBUG_PRINT("Inodo %u escrito correctamente en bloque %u, offset %u\n", inode_number, sb->inode_start + block_index,
@@ -82,13 +89,75 @@ int write_inode(const char *image_path, uint32_t inode_number, const struct inod
     return 0;
 }
 
-int free_inode(const char *image_path, uint32_t inode_number) {
+int dev_read_inodes(struct vfs_device *dev, uint32_t first, uint32_t count, struct inode *out) {
+    // Lee los count nodos-I consecutivos que empiezan en first y los copia en out[0..count-1]
+    // Cada bloque de la tabla se lee una sola vez, y con la cache de nodos-I los que
+    // falten se leen todos juntos
+    // Retorna 0 o -1 si encuentra un error
+
+    if (dev->icache)
+        return icache_read_range(dev, first, count, out);
+
+    struct superblock sb_struct, *sb = &sb_struct;
+    if (dev_read_superblock(dev, sb) != 0) {
+        fprintf(stderr, "Error al leer superblock\n");
+        return -1;
+    }
+
+    if (first >= sb->inode_count || count > sb->inode_count - first) {
+        fprintf(stderr, "Error en read_inodes: rango de nodos-I inválido (%u, %u)\n", first, count);
+        return -1;
+    }
+
+    uint32_t i = 0;
+    while (i < count) {
+        uint32_t inode_number = first + i;
+        uint8_t inode_block_buffer[BLOCK_SIZE];
+        if (dev_read_block(dev, sb->inode_start + inode_number / INODES_PER_BLOCK, inode_block_buffer) != 0)
+            return -1;
+
+        const struct inode *inodes = (const struct inode *)inode_block_buffer;
+        for (uint32_t j = inode_number % INODES_PER_BLOCK; j < INODES_PER_BLOCK && i < count; j++)
+            out[i++] = inodes[j];
+    }
+
+    return 0;
+}
+
+int dev_inode_prefetch(struct vfs_device *dev, const uint32_t *inode_numbers, size_t count) {
+    // Anticipa la lectura de los nodos-I indicados: con la cache de nodos-I, los bloques
+    // de la tabla que falten se leen todos juntos, y las lecturas siguientes de esos
+    // nodos-I no acceden a la imagen. Sin la cache no hace nada
+    // Retorna 0 o -1 si encuentra un error
+    if (!dev->icache)
+        return 0;
+    return icache_prefetch(dev, inode_numbers, count);
+}
+
+static int ibitmap_mark(struct vfs_device *dev, const struct superblock *sb, uint32_t inode_number, int used) {
+    // Marca inode_number como ocupado (used en 1) o libre en el bitmap de nodos-I
+    // Retorna 0 o -1 en caso de error
+    uint32_t block = sb->ibitmap_start + inode_number / BITS_PER_BLOCK;
+    uint32_t bit = inode_number % BITS_PER_BLOCK;
+    uint8_t buffer[BLOCK_SIZE];
+
+    if (dev_read_block(dev, block, buffer) != 0)
+        return -1;
+
+    if (used)
+        buffer[bit / 8] |= 1 << (7 - bit % 8);
+    else
+        buffer[bit / 8] &= ~(1 << (7 - bit % 8));
+    return dev_write_block(dev, block, buffer);
+}
+
+int dev_free_inode(struct vfs_device *dev, uint32_t inode_number) {
     // Libera un (supuestamente ocupado) nodo-I
     // retorna 0 si lo hace, -1 si encuentra un error
     struct superblock sb_struct, *sb = &sb_struct;
 
     // Leer el superbloque
-    if (read_superblock(image_path, sb) != 0) {
+    if (dev_read_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error al leer superblock\n");
         return -1;
     }
@@ -99,7 +168,7 @@ int free_inode(const char *image_path, uint32_t inode_number) {
     }
 
     struct inode in;
-    if (read_inode(image_path, inode_number, &in) != 0) {
+    if (dev_read_inode(dev, inode_number, &in) != 0) {
         fprintf(stderr, "Error al leer nodo-I nro %d\n", inode_number);
         return -1;
     }
@@ -112,14 +181,21 @@ int free_inode(const char *image_path, uint32_t inode_number) {
     // Marcar nodo-I como libre
     memset(&in, 0, sizeof(struct inode));
 
-    if (write_inode(image_path, inode_number, &in) != 0) {
+    if (dev_write_inode(dev, inode_number, &in) != 0) {
         fprintf(stderr, "Error al escribir nodo-I liberado %d\n", inode_number);
         return -1;
     }
 
+    if ((sb->features & VFS_FEATURE_INODE_BITMAP) && ibitmap_mark(dev, sb, inode_number, 0) != 0) {
+        fprintf(stderr, "Error al actualizar el bitmap de nodos-I\n");
+        return -1;
+    }
+
     sb->free_inodes++;
+    if (sb->inode_hint == 0 || inode_number < sb->inode_hint)
+        sb->inode_hint = inode_number;
 
-    if (write_superblock(image_path, sb) != 0) {
+    if (dev_write_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error al actualizar superbloque\n");
         return -1;
     }
@@ -128,29 +204,37 @@ int free_inode(const char *image_path, uint32_t inode_number) {
     return 0;
 }
 
-int get_block_number_at(const char *image_path, struct inode *in, uint16_t index) {
-    // funcion prevista para ir "avanzando" bloque a bloque al procesar un archivo
+int dev_get_block_number_at(struct vfs_device *dev, struct inode *in, uint16_t index) {
     // retorna el nro de bloque de la posicion index (0, 1, ...) asociado al inode *in
     // recorre primero los directos, luego los indirectos
-    // retorna -1 si encuentra un error, o 0 si index esta fuera de rango
+    // retorna -1 si encuentra un error, o 0 si index esta fuera de rango o es un hueco
+    // Cada invocación con index >= NUM_DIRECT_PTRS lee el bloque indirecto: para recorrer
+    // un archivo conviene usar un cursor, ver dev_bmap_next()
 
     if (index >= in->blocks) {
         DEBUG_PRINT("index %u >= in->blocks %u\n", index, in->blocks);
         return 0; // No es un error, tal vez fue mal invocada
     }
 
+    if (in->mode & INODE_MODE_EXTENTS) {
+        struct bmap_cursor cur;
+        uint32_t start, len;
+        bmap_cursor_init(&cur, in, index);
+        if (dev_bmap_next(dev, &cur, 1, &start, &len) != 1)
+            return -1;
+        return start;
+    }
+
     if (index < NUM_DIRECT_PTRS) {
         // Acceso a puntero directo
         return in->direct[index];
     } else {
         // Acceso al bloque indirecto
         uint8_t buffer[BLOCK_SIZE];
-        if (in->indirect == 0) {
-            fprintf(stderr, "Error: bloque indirecto es 0, con index %d y in->blocks %u\n", index, in->blocks);
-            return -1;
-        }
+        if (in->indirect == 0)
+            return 0; // sin bloque indirecto, todas sus posiciones son huecos
 
-        if (read_block(image_path, in->indirect, buffer) != 0) {
+        if (dev_read_block(dev, in->indirect, buffer) != 0) {
             fprintf(stderr, "Error al leer el bloque indirecto %u: %s\n", in->indirect, strerror(errno));
             return -1;
         }
@@ -168,7 +252,281 @@ int get_block_number_at(const char *image_path, struct inode *in, uint16_t index
     }
 }
 
-int create_empty_file_in_free_inode(const char *image_path, uint16_t perms) {
+void bmap_cursor_init(struct bmap_cursor *cur, const struct inode *in, uint32_t index) {
+    // Prepara cur para recorrer los bloques del archivo *in a partir del bloque lógico index
+    cur->in = in;
+    cur->index = index;
+    cur->ext_pos = 0;
+    cur->map_block = 0;
+}
+
+static void extents_get(const struct inode *in, struct inode_extents *ie) {
+    // Copia los extents guardados en direct[] e indirect de un nodo-I con INODE_MODE_EXTENTS
+    memcpy(ie, (const uint8_t *)in + offsetof(struct inode, direct), sizeof(struct inode_extents));
+}
+
+static void extents_put(struct inode *in, const struct inode_extents *ie) {
+    memcpy((uint8_t *)in + offsetof(struct inode, direct), ie, sizeof(struct inode_extents));
+}
+
+static int bmap_load(struct vfs_device *dev, struct bmap_cursor *cur, uint32_t block) {
+    // Lee en el cursor el bloque indirecto o de desborde block, si no es el que ya tiene cargado
+    // Retorna 0 o -1 en caso de error
+    if (block != 0 && block == cur->map_block)
+        return 0;
+
+    if (block == 0) {
+        fprintf(stderr, "Error: bloque indirecto es 0, con index %u y in->blocks %u\n", cur->index, cur->in->blocks);
+        return -1;
+    }
+
+    if (dev_read_block(dev, block, &cur->map) != 0) {
+        fprintf(stderr, "Error al leer el bloque indirecto %u: %s\n", block, strerror(errno));
+        return -1;
+    }
+
+    cur->map_block = block;
+    return 0;
+}
+
+static int bmap_next_extent(struct vfs_device *dev, struct bmap_cursor *cur, uint32_t max_len, uint32_t *start,
+                            uint32_t *len) {
+    // dev_bmap_next() para nodos-I con INODE_MODE_EXTENTS
+    struct inode_extents ie;
+    extents_get(cur->in, &ie);
+
+    const struct extent *ext = ie.ext;
+    uint32_t count = ie.count;
+    if (ie.spill != 0) {
+        if (bmap_load(dev, cur, ie.spill) != 0)
+            return -1;
+        ext = cur->map.extents.ext;
+        count = cur->map.extents.count;
+    }
+    if (count > NUM_SPILL_EXTENTS) {
+        fprintf(stderr, "Error: cantidad de extents inválida (%u)\n", count);
+        return -1;
+    }
+
+    // Los recorridos son secuenciales: se sigue desde el primer extent que no termina antes de index
+    if (cur->ext_pos > count ||
+        (cur->ext_pos > 0 && (uint32_t)ext[cur->ext_pos - 1].logical + ext[cur->ext_pos - 1].len > cur->index))
+        cur->ext_pos = 0;
+    while (cur->ext_pos < count && (uint32_t)ext[cur->ext_pos].logical + ext[cur->ext_pos].len <= cur->index)
+        cur->ext_pos++;
+
+    uint32_t n = cur->in->blocks - cur->index;
+    if (n > max_len)
+        n = max_len;
+
+    const struct extent *e = &ext[cur->ext_pos];
+    if (cur->ext_pos == count || e->logical > cur->index) {
+        // Hueco hasta el próximo extent, o hasta el final del archivo
+        if (cur->ext_pos < count && n > e->logical - cur->index)
+            n = e->logical - cur->index;
+        *start = 0;
+    } else if (e->start == 0) {
+        fprintf(stderr, "Error: extent inválido en el bloque lógico %u del archivo\n", cur->index);
+        return -1;
+    } else {
+        uint32_t offset = cur->index - e->logical;
+        if (n > e->len - offset)
+            n = e->len - offset;
+        *start = e->start + offset;
+    }
+
+    *len = n;
+    cur->index += n;
+    return 1;
+}
+
+int dev_bmap_next(struct vfs_device *dev, struct bmap_cursor *cur, uint32_t max_len, uint32_t *start, uint32_t *len) {
+    // Devuelve en *start y *len la próxima corrida de bloques físicamente contiguos del archivo,
+    // de hasta max_len bloques, y avanza el cursor hasta el bloque lógico que le sigue
+    // Un hueco (bloques lógicos sin bloque asignado) se devuelve como una corrida con *start en 0
+    // Retorna 1 si hay una corrida, 0 si el recorrido terminó, o -1 si encuentra un error
+    const struct inode *in = cur->in;
+    if (cur->index >= in->blocks || max_len == 0)
+        return 0;
+
+    if (in->mode & INODE_MODE_EXTENTS)
+        return bmap_next_extent(dev, cur, max_len, start, len);
+
+    uint32_t first = 0, count = 0;
+    while (cur->index < in->blocks && count < max_len) {
+        uint32_t block;
+        if (cur->index < NUM_DIRECT_PTRS) {
+            block = in->direct[cur->index];
+        } else {
+            uint32_t indirect_index = cur->index - NUM_DIRECT_PTRS;
+            if (indirect_index >= NUM_INDIRECT_PTRS) {
+                fprintf(stderr, "Error inesperado. indirect_index %u es mayor que %zu\n", indirect_index,
+                        NUM_INDIRECT_PTRS);
+                return -1;
+            }
+            if (in->indirect == 0) {
+                block = 0; // sin bloque indirecto, todas sus posiciones son huecos
+            } else {
+                if (bmap_load(dev, cur, in->indirect) != 0)
+                    return -1;
+                block = cur->map.indirect[indirect_index];
+            }
+        }
+
+        // Termina la corrida si el bloque no sigue al anterior, o si empieza o termina un hueco;
+        // el bloque se devuelve en la próxima
+        if (count > 0 && (first == 0 ? block != 0 : block != first + count))
+            break;
+
+        if (count == 0)
+            first = block;
+        count++;
+        cur->index++;
+    }
+
+    *start = first;
+    *len = count;
+    return 1;
+}
+
+int dev_inode_allocated_blocks(struct vfs_device *dev, const struct inode *in, uint32_t *allocated) {
+    // Deja en *allocated la cantidad de bloques de datos asignados al archivo: in->blocks es su largo
+    // en bloques y cuenta también los huecos. No cuenta el bloque indirecto ni el de extents
+    // Retorna 0 o -1 en caso de error
+    struct bmap_cursor cur;
+    bmap_cursor_init(&cur, in, 0);
+    uint32_t start, len;
+    int r;
+    *allocated = 0;
+    while ((r = dev_bmap_next(dev, &cur, UINT32_MAX, &start, &len)) == 1)
+        if (start != 0)
+            *allocated += len;
+    return r;
+}
+
+uint32_t inode_max_blocks(const struct inode *in) {
+    // Cantidad máxima de bloques de datos que puede tener el archivo según su formato
+    if (in->mode & INODE_MODE_EXTENTS)
+        return MAX_EXTENT_FILE_BLOCKS;
+    return NUM_DIRECT_PTRS + NUM_INDIRECT_PTRS;
+}
+
+static int find_free_inode_from(struct vfs_device *dev, const struct superblock *sb, uint32_t from) {
+    // Busca el primer nodo-I libre a partir de from
+    // Con bitmap de nodos-I busca de a palabras con bitmap_first_zero(); el bit lo marca el llamador
+    // una vez escrito el nodo-I. Sin él (imágenes anteriores) recorre la tabla de a un bloque con
+    // dev_read_inodes()
+    // Un programa anterior al bitmap asigna nodos-I por mode == 0 sin marcar su bit: por eso
+    // cada candidato del bitmap se verifica en la tabla, y si está en uso se marca y se sigue
+    // Retorna el nro de nodo-I, 0 si no hay ninguno libre, o -1 en caso de error
+
+    if (sb->features & VFS_FEATURE_INODE_BITMAP) {
+        for (uint32_t i = from / BITS_PER_BLOCK; i < sb->ibitmap_blocks; i++) {
+            uint8_t buffer[BLOCK_SIZE];
+            uint32_t first = i * BITS_PER_BLOCK;
+            uint32_t nbits = sb->inode_count - first < BITS_PER_BLOCK ? sb->inode_count - first : BITS_PER_BLOCK;
+
+            if (dev_read_block(dev, sb->ibitmap_start + i, buffer) != 0)
+                return -1;
+
+            int repaired = 0;
+            int bit = bitmap_first_zero(buffer, from > first ? from - first : 0, nbits);
+            while (bit >= 0) {
+                struct inode in;
+                if (dev_read_inode(dev, first + bit, &in) != 0)
+                    return -1;
+
+                if (in.mode == 0)
+                    break;
+
+                DEBUG_PRINT("Nodo-I %u en uso sin su bit en el bitmap, se marca\n", first + bit);
+                buffer[bit / 8] |= 1 << (7 - bit % 8);
+                repaired = 1;
+                bit = bitmap_first_zero(buffer, bit + 1, nbits);
+            }
+
+            if (repaired && dev_write_block(dev, sb->ibitmap_start + i, buffer) != 0)
+                return -1;
+            if (bit >= 0)
+                return first + bit;
+        }
+        return 0;
+    }
+
+    for (uint32_t first = from; first < sb->inode_count;) {
+        struct inode inodes[INODES_PER_BLOCK];
+        uint32_t count = INODES_PER_BLOCK - first % INODES_PER_BLOCK;
+        if (count > sb->inode_count - first)
+            count = sb->inode_count - first;
+
+        if (dev_read_inodes(dev, first, count, inodes) != 0)
+            return -1;
+
+        for (uint32_t j = 0; j < count; j++)
+            if (inodes[j].mode == 0)
+                return first + j;
+        first += count;
+    }
+    return 0;
+}
+
+static int ibitmap_resync(struct vfs_device *dev, const struct superblock *sb) {
+    // Borra del bitmap de nodos-I los bits de los nodos-I libres en la tabla: un programa anterior
+    // al bitmap libera un nodo-I poniendo mode en 0 sin tocar su bit, que queda ocupado para siempre
+    // Retorna el primer nodo-I libre que encontró así, 0 si no hay ninguno, o -1 en caso de error
+    int found = 0;
+    for (uint32_t i = 0; i < sb->ibitmap_blocks; i++) {
+        uint8_t buffer[BLOCK_SIZE];
+        uint32_t first = i * BITS_PER_BLOCK;
+        uint32_t nbits = sb->inode_count - first < BITS_PER_BLOCK ? sb->inode_count - first : BITS_PER_BLOCK;
+
+        if (dev_read_block(dev, sb->ibitmap_start + i, buffer) != 0)
+            return -1;
+
+        int changed = 0;
+        for (uint32_t bit = 0; bit < nbits;) {
+            struct inode inodes[INODES_PER_BLOCK];
+            uint32_t count = nbits - bit < INODES_PER_BLOCK ? nbits - bit : INODES_PER_BLOCK;
+            if (dev_read_inodes(dev, first + bit, count, inodes) != 0)
+                return -1;
+
+            for (uint32_t j = 0; j < count; j++, bit++) {
+                uint8_t mask = 1 << (7 - bit % 8);
+                if (first + bit <= ROOTDIR_INODE || inodes[j].mode != 0 || !(buffer[bit / 8] & mask))
+                    continue;
+
+                DEBUG_PRINT("Nodo-I %u libre con su bit en el bitmap, se borra\n", first + bit);
+                buffer[bit / 8] &= ~mask;
+                changed = 1;
+                if (found == 0)
+                    found = first + bit;
+            }
+        }
+
+        if (changed && dev_write_block(dev, sb->ibitmap_start + i, buffer) != 0)
+            return -1;
+    }
+    return found;
+}
+
+static int find_free_inode(struct vfs_device *dev, const struct superblock *sb) {
+    // Busca un nodo-I libre empezando por sb->inode_hint; si no encuentra ninguno
+    // (la pista quedó adelantada) vuelve a buscar desde el principio
+    // Si el bitmap no tiene ninguno pero el superbloque dice que quedan, revisa la tabla con
+    // ibitmap_resync()
+    // Retorna el nro de nodo-I, 0 si no hay ninguno libre, o -1 en caso de error
+    uint32_t first = ROOTDIR_INODE + 1;
+    uint32_t from = sb->inode_hint > first ? sb->inode_hint : first;
+
+    int inode_nbr = find_free_inode_from(dev, sb, from);
+    if (inode_nbr == 0 && from > first)
+        inode_nbr = find_free_inode_from(dev, sb, first);
+    if (inode_nbr == 0 && (sb->features & VFS_FEATURE_INODE_BITMAP) && sb->free_inodes > 0)
+        inode_nbr = ibitmap_resync(dev, sb);
+    return inode_nbr;
+}
+
+int dev_create_empty_file_in_free_inode(struct vfs_device *dev, uint16_t perms) {
     // Busca un nodo-I vacio para un archivo nuevo, inicialmente sin datos
     // Pone valores iniciales en el nodo-I
     // El unico valor que acepta como argumento para el nodo-I son los permisos perms
@@ -177,7 +535,7 @@ int create_empty_file_in_free_inode(const char *image_path, uint16_t perms) {
     struct superblock sb_struct, *sb = &sb_struct;
 
     // Leer el superbloque
-    if (read_superblock(image_path, sb) != 0) {
+    if (dev_read_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error al leer superblock\n");
         return -1;
     }
@@ -189,155 +547,363 @@ int create_empty_file_in_free_inode(const char *image_path, uint16_t perms) {
     }
 
     // Buscar un inodo libre
-    for (uint32_t inode_nbr = ROOTDIR_INODE + 1; inode_nbr < sb->inode_count; inode_nbr++) {
-        struct inode tmp_inode;
+    int inode_nbr = find_free_inode(dev, sb);
+    if (inode_nbr < 0)
+        return -1;
+    if (inode_nbr == 0) {
+        // no hay mas nodos-I libres, aunque free_inodes diga lo contrario
+        errno = ENOSPC;
+        return -1;
+    }
+    DEBUG_PRINT("Encontrado nodo-I libre nro %d.\n", inode_nbr);
+
+    // Inicializar y luego escribir el inodo con valores por defecto, excepto perms
+    struct inode in_struct = {0}, *in = &in_struct;
+    in->mode = INODE_MODE_FILE | perms;
+    if (sb->features & VFS_FEATURE_EXTENTS)
+        in->mode |= INODE_MODE_EXTENTS;
+    if (sb->features & VFS_FEATURE_INLINE_DATA)
+        in->mode |= INODE_MODE_INLINE; // pasa a bloques cuando supera INODE_INLINE_SIZE bytes
+    in->uid = getuid();
+    in->gid = getgid();
+    in->blocks = 0;
+    in->size = 0;
 
-        if (read_inode(image_path, inode_nbr, &tmp_inode) != 0)
-            return -1;
-        if (tmp_inode.mode == 0) { // inodo libre
-            DEBUG_PRINT("Encontrado nodo-I libre nro %u.\n", inode_nbr);
-
-            // Inicializar y luego escribir el inodo con valores por defecto, excepto perms
-            struct inode in_struct = {0}, *in = &in_struct;
-            in->mode = INODE_MODE_FILE | perms;
-            in->uid = getuid();
-            in->gid = getgid();
-            in->blocks = 0;
-            in->size = 0;
-
-            time_t now = time(NULL);
-            in->atime = in->mtime = in->ctime = (uint32_t)now;
-
-            if (write_inode(image_path, inode_nbr, in) != 0) {
-                fprintf(stderr, "Error al escribir nodo-I nro %u.\n", inode_nbr);
+    time_t now = time(NULL);
+    in->atime = in->mtime = in->ctime = (uint32_t)now;
+
+    if (dev_write_inode(dev, inode_nbr, in) != 0) {
+        fprintf(stderr, "Error al escribir nodo-I nro %d.\n", inode_nbr);
+        return -1;
+    }
+
+    // El bit se marca recién con el nodo-I escrito: si algo falla antes, el nodo-I sigue libre
+    if ((sb->features & VFS_FEATURE_INODE_BITMAP) && ibitmap_mark(dev, sb, inode_nbr, 1) != 0) {
+        fprintf(stderr, "Error al actualizar el bitmap de nodos-I\n");
+        return -1;
+    }
+
+    // Actualiza y reescribe superbloque: todos los anteriores a inode_nbr siguen ocupados
+    sb->free_inodes--;
+    sb->inode_hint = inode_nbr + 1;
+
+    if (dev_write_superblock(dev, sb) != 0) {
+        fprintf(stderr, "Error: no se pudo escribir el superbloque\n");
+        return -1;
+    }
+
+    return inode_nbr;
+}
+
+static int map_pointers(struct vfs_device *dev, struct inode *in, uint32_t logical, uint32_t start, uint32_t count) {
+    // dev_inode_map_extent() para nodos-I con punteros: completa los directos y luego el bloque
+    // indirecto, que se lee y se escribe una sola vez
+    if (logical + count > NUM_DIRECT_PTRS + NUM_INDIRECT_PTRS) {
+        fprintf(stderr, "Error: El archivo ha alcanzado el límite de bloques\n");
+        errno = EFBIG;
+        return -1;
+    }
+
+    uint32_t end = logical + count;
+    while (logical < end && logical < NUM_DIRECT_PTRS)
+        in->direct[logical++] = start++;
+
+    if (logical < end) {
+        // Si ya esta usado el bloque indirecto, lo leemos; si no, lo inicializamos
+        uint32_t indirect_block[NUM_INDIRECT_PTRS] = {0}; // inicializado en 0
+
+        if (in->indirect == 0) {
+            // indirecto NO Existe: Asignamos nuevo bloque para punteros indirectos
+            int indirect_block_num = dev_bitmap_set_first_free(dev);
+            if (indirect_block_num == -1) {
+                fprintf(stderr, "No hay bloques disponibles para el bloque indirecto\n");
                 return -1;
             }
 
-            // Actualiza y reescribe superbloque
-            sb->free_inodes--;
+            in->indirect = indirect_block_num;
 
-            if (write_superblock(image_path, sb) != 0) {
-                fprintf(stderr, "Error: no se pudo escribir el superbloque\n");
+        } else {
+            // EXISTE: Leemos el bloque indirecto existente
+            if (dev_read_block(dev, in->indirect, indirect_block) != 0) {
+                fprintf(stderr, "Error leyendo el bloque indirecto nro. %u\n", in->indirect);
                 return -1;
             }
+        }
+
+        for (; logical < end; logical++)
+            indirect_block[logical - NUM_DIRECT_PTRS] = start++;
 
-            return inode_nbr;
+        // Escribir a "disco" el bloque indirecto actualizado
+        if (dev_write_block(dev, in->indirect, indirect_block) != 0) {
+            fprintf(stderr, "Error escribiendo el bloque indirecto nro. %u\n", in->indirect);
+            return -1;
         }
     }
 
-    // si llegamos a este punto sin retornar, es que no hay mas nodos-I libres
-    errno = ENOSPC;
-    return -1;
+    if (end > in->blocks)
+        in->blocks = end;
+    return 0;
 }
 
-int inode_append_block(const char *image_path, struct inode *in, uint32_t new_block_number) {
-    // Agrega bloque nro new_block_number al final de los bloques del archivo
+static uint32_t extents_merge(struct extent *ext, uint32_t n) {
+    // Une los extents vecinos que son contiguos tanto en bloques lógicos como físicos
+    // Retorna la nueva cantidad de extents
+    uint32_t out = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        struct extent *prev = out > 0 ? &ext[out - 1] : NULL;
+        if (prev && prev->logical + prev->len == ext[i].logical && prev->start + prev->len == ext[i].start &&
+            (uint32_t)prev->len + ext[i].len <= UINT16_MAX)
+            prev->len += ext[i].len;
+        else
+            ext[out++] = ext[i];
+    }
+    return out;
+}
+
+static int map_extents(struct vfs_device *dev, struct inode *in, uint32_t logical, uint32_t start, uint32_t count) {
+    // dev_inode_map_extent() para nodos-I con INODE_MODE_EXTENTS: la corrida se inserta en orden de
+    // bloque lógico y se une con sus vecinos si les sigue físicamente. Cuando no caben más extents
+    // en el nodo-I, todos pasan a un bloque de desborde
+    if (logical + count > MAX_EXTENT_FILE_BLOCKS) {
+        fprintf(stderr, "Error: El archivo ha alcanzado el límite de bloques\n");
+        errno = EFBIG;
+        return -1;
+    }
+
+    struct inode_extents ie;
+    extents_get(in, &ie);
+
+    struct extent_block eb;
+    struct extent *ext = ie.ext;
+    uint32_t n = ie.count, max = NUM_INLINE_EXTENTS;
+    if (ie.spill != 0) {
+        if (dev_read_block(dev, ie.spill, &eb) != 0) {
+            fprintf(stderr, "Error leyendo el bloque de extents nro. %u\n", ie.spill);
+            return -1;
+        }
+        ext = eb.ext;
+        n = eb.count;
+        max = NUM_SPILL_EXTENTS;
+        if (n > max) {
+            fprintf(stderr, "Error: cantidad de extents inválida (%u)\n", n);
+            return -1;
+        }
+    }
+
+    uint32_t new_spill = 0; // Bloque de desborde pedido en esta llamada, se libera si algo falla
+    while (count > 0) {
+        // Posición del primer extent que empieza después de logical
+        uint32_t pos = 0;
+        while (pos < n && ext[pos].logical < logical)
+            pos++;
+
+        struct extent *prev = pos > 0 ? &ext[pos - 1] : NULL;
+        uint32_t added;
+
+        if (prev && prev->logical + prev->len == logical && prev->start + prev->len == start &&
+            prev->len < UINT16_MAX) {
+            added = UINT16_MAX - prev->len;
+            if (added > count)
+                added = count;
+            prev->len += added;
+        } else if (n < max) {
+            added = count < UINT16_MAX ? count : UINT16_MAX;
+            memmove(&ext[pos + 1], &ext[pos], (n - pos) * sizeof(struct extent));
+            ext[pos].logical = logical;
+            ext[pos].len = added;
+            ext[pos].start = start;
+            n++;
+        } else if (ie.spill == 0) {
+            // No caben más extents en el nodo-I: pasarlos a un bloque de desborde
+            int spill = dev_bitmap_set_first_free(dev);
+            if (spill == -1) {
+                fprintf(stderr, "No hay bloques disponibles para el bloque de extents\n");
+                return -1;
+            }
+            new_spill = spill;
+            memset(&eb, 0, sizeof(eb));
+            memcpy(eb.ext, ie.ext, n * sizeof(struct extent));
+            memset(ie.ext, 0, sizeof(ie.ext));
+            ie.count = 0;
+            ie.spill = spill;
+            ext = eb.ext;
+            max = NUM_SPILL_EXTENTS;
+            continue;
+        } else {
+            fprintf(stderr, "Error: El archivo tiene demasiados extents (%u)\n", n);
+            if (new_spill != 0)
+                dev_bitmap_free_block(dev, new_spill);
+            errno = EFBIG;
+            return -1;
+        }
+
+        logical += added;
+        start += added;
+        count -= added;
+    }
+
+    // Rellenar un hueco puede dejar la corrida pegada también al extent siguiente
+    n = extents_merge(ext, n);
+
+    if (ie.spill != 0) {
+        eb.count = n;
+        if (dev_write_block(dev, ie.spill, &eb) != 0) {
+            fprintf(stderr, "Error escribiendo el bloque de extents nro. %u\n", ie.spill);
+            if (new_spill != 0) {
+                int saved_errno = errno;
+                dev_bitmap_free_block(dev, new_spill);
+                errno = saved_errno;
+            }
+            return -1;
+        }
+    } else {
+        ie.count = n;
+    }
+
+    extents_put(in, &ie);
+    if (logical > in->blocks)
+        in->blocks = logical;
+    return 0;
+}
+
+int dev_inode_map_extent(struct vfs_device *dev, struct inode *in, uint32_t logical, uint32_t start, uint32_t count) {
+    // Asigna los bloques start a start + count - 1 a los bloques lógicos logical a logical + count - 1
+    // del archivo, que deben ser huecos o estar después del final; si están después, el archivo crece
     // Retorna 0 si ejecuta bien, o -1 en caso de error
     // Es responsabilidad del llamador
     //      1. escribir a disco el nodo-I actualizado
-    //      2. que new_block_number sea un bloque valido sin usar, pero marcado ocupado en el bitmap
+    //      2. que los bloques sean validos sin usar, pero marcados ocupados en el bitmap
 
     struct superblock sb_struct, *sb = &sb_struct;
 
     // Leer el superbloque para validar argumentos
-    if (read_superblock(image_path, sb) != 0) {
+    if (dev_read_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error al leer superblock\n");
         return -1;
     }
 
-    if (new_block_number < sb->data_start || new_block_number >= sb->total_blocks) {
-        fprintf(stderr, "Bloque %u fuera de rango para agregar a archivo.\n", new_block_number);
+    if (count == 0 || start < sb->data_start || start >= sb->total_blocks || count > sb->total_blocks - start) {
+        fprintf(stderr, "Bloques %u a %u fuera de rango para agregar a archivo.\n", start, start + count - 1);
         return -1;
     }
 
-    // Verificamos espacio en los punteros directos
-    for (int i = 0; i < NUM_DIRECT_PTRS; i++) {
-        if (in->direct[i] == 0) { // encontro un puntero directo libre
-            in->direct[i] = new_block_number;
-            in->blocks++;
-            return 0;
-        }
-    }
+    if (in->mode & INODE_MODE_EXTENTS)
+        return map_extents(dev, in, logical, start, count);
+    return map_pointers(dev, in, logical, start, count);
+}
 
-    // Bloques directos ocupados, vamos a los indirectos
-    // Si ya esta usado el bloque indirecto, lo leemos; si no, lo inicializamos
-    uint32_t indirect_block[NUM_INDIRECT_PTRS] = {0}; // inicializado en 0
+int dev_inode_append_extent(struct vfs_device *dev, struct inode *in, uint32_t start, uint32_t count) {
+    // Agrega los bloques start a start + count - 1 al final de los bloques del archivo
+    // Retorna 0 si ejecuta bien, o -1 en caso de error; ver dev_inode_map_extent()
+    return dev_inode_map_extent(dev, in, in->blocks, start, count);
+}
 
-    if (in->indirect == 0) {
-        // indirecto NO Existe: Asignamos nuevo bloque para punteros indirectos
-        int indirect_block_num = bitmap_set_first_free(image_path);
-        if (indirect_block_num == -1) {
-            fprintf(stderr, "No hay bloques disponibles para el bloque indirecto\n");
-            return -1;
-        }
+int dev_inode_append_block(struct vfs_device *dev, struct inode *in, uint32_t new_block_number) {
+    // Agrega bloque nro new_block_number al final de los bloques del archivo
+    // Retorna 0 si ejecuta bien, o -1 en caso de error
+    // Es responsabilidad del llamador
+    //      1. escribir a disco el nodo-I actualizado
+    //      2. que new_block_number sea un bloque valido sin usar, pero marcado ocupado en el bitmap
+    return dev_inode_append_extent(dev, in, new_block_number, 1);
+}
 
-        in->indirect = indirect_block_num;
+static int trunc_extents(struct vfs_device *dev, struct inode *in) {
+    // dev_inode_trunc_data() para nodos-I con INODE_MODE_EXTENTS
+    // Retorna 0 o -1 en caso de error
+    uint32_t *to_free = malloc(((size_t)in->blocks + 1) * sizeof(uint32_t));
+    if (!to_free)
+        return -1;
 
-    } else {
-        // EXISTE: Leemos el bloque indirecto existente
-        if (read_block(image_path, in->indirect, indirect_block) != 0) {
-            fprintf(stderr, "Error leyendo el bloque indirecto nro. %u\n", in->indirect);
-            return -1;
-        }
+    size_t count = 0;
+    struct bmap_cursor cur;
+    uint32_t start, len;
+    int r;
+    bmap_cursor_init(&cur, in, 0);
+    while ((r = dev_bmap_next(dev, &cur, UINT32_MAX, &start, &len)) == 1) {
+        if (start == 0)
+            continue; // hueco
+        DEBUG_PRINT("Liberando extent: %u bloques desde %u\n", len, start);
+        for (uint32_t i = 0; i < len; i++)
+            to_free[count++] = start + i;
+    }
+    if (r < 0) {
+        free(to_free);
+        return -1;
     }
 
-    // Buscar una posición libre en el bloque indirecto
-    for (uint32_t i = 0; i < NUM_INDIRECT_PTRS; i++) {
-        if (indirect_block[i] == 0) { // buscamos al primer bloque en 0
-            indirect_block[i] = new_block_number;
+    struct inode_extents ie;
+    extents_get(in, &ie);
+    if (ie.spill != 0) {
+        DEBUG_PRINT("Liberando bloque de extents: %u\n", ie.spill);
+        to_free[count++] = ie.spill;
+    }
 
-            // Escribir a "disco" el bloque indirecto actualizado
-            if (write_block(image_path, in->indirect, indirect_block) != 0) {
-                fprintf(stderr, "Error escribiendo el bloque indirecto nro. %u\n", in->indirect);
-                return -1;
-            }
+    memset(&ie, 0, sizeof(ie));
+    extents_put(in, &ie);
 
-            in->blocks++;
-            return 0;
-        }
-    }
+    if (dev_bitmap_free_blocks(dev, to_free, count) != 0)
+        fprintf(stderr, "Error al liberar los bloques del archivo\n");
 
-    // No hay espacio ni en directos ni en indirectos
-    fprintf(stderr, "Error: El archivo ha alcanzado el límite de bloques\n");
-    return -1;
+    free(to_free);
+    return 0;
 }
 
-int inode_trunc_data(const char *image_path, struct inode *in) {
+int dev_inode_trunc_data(struct vfs_device *dev, struct inode *in) {
     // Elimina todos los bloques de datos del archivo,
     // marcandolos como libres en el bitmap y actualizando indirectamente el superblock
+    // Los bloques se juntan en una lista y se liberan en un solo lote con dev_bitmap_free_blocks
     // Retorna 0 si ejecuta bien, o -1 en caso de error
+    if (in->mode & (INODE_MODE_INLINE | INODE_MODE_EXTENTS)) {
+        if (in->mode & INODE_MODE_INLINE)
+            memset((uint8_t *)in + offsetof(struct inode, direct), 0, INODE_INLINE_SIZE); // sin bloques
+        else if (trunc_extents(dev, in) != 0)
+            return -1;
+
+        DEBUG_PRINT("Archivo truncado: tamaño y bloques puestos en cero\n");
+        in->size = 0;
+        in->blocks = 0;
+        time_t now = time(NULL);
+        in->mtime = in->atime = now;
+        return 0;
+    }
+
+    uint32_t to_free[NUM_DIRECT_PTRS + NUM_INDIRECT_PTRS + 1];
+    size_t count = 0;
 
-    // Liberar bloques directos
+    // Bloques directos
     for (int i = 0; i < NUM_DIRECT_PTRS; i++) {
         if (in->direct[i] != 0) {
             DEBUG_PRINT("Liberando bloque directo #%d: %u\n", i, in->direct[i]);
-            bitmap_free_block(image_path, in->direct[i]);
+            to_free[count++] = in->direct[i];
             in->direct[i] = 0;
         }
     }
 
-    // Liberar bloques indirectos, a partir del bloque de punteros indirectos
+    // Bloques indirectos, a partir del bloque de punteros indirectos
     if (in->indirect != 0) {
         DEBUG_PRINT("Leyendo bloque indirecto: %u\n", in->indirect);
 
         uint32_t indirect_block[NUM_INDIRECT_PTRS];
-        if (read_block(image_path, in->indirect, indirect_block) != 0) {
+        if (dev_read_block(dev, in->indirect, indirect_block) != 0) {
             fprintf(stderr, "Error al leer bloque indirecto nro %u.\n", in->indirect);
             return -1;
         } else {
             for (size_t j = 0; j < NUM_INDIRECT_PTRS; j++) {
                 if (indirect_block[j] != 0) {
                     DEBUG_PRINT("Liberando bloque referenciado indirecto #%zu: %u\n", j, indirect_block[j]);
-                    bitmap_free_block(image_path, indirect_block[j]);
+                    to_free[count++] = indirect_block[j];
                 }
             }
         }
 
         DEBUG_PRINT("Liberando bloque de punteros indirectos: %u\n", in->indirect);
-        bitmap_free_block(image_path, in->indirect);
+        to_free[count++] = in->indirect;
         in->indirect = 0;
     }
 
+    if (dev_bitmap_free_blocks(dev, to_free, count) != 0)
+        fprintf(stderr, "Error al liberar los bloques del archivo\n");
+
     DEBUG_PRINT("Archivo truncado: tamaño y bloques puestos en cero\n");
 
     in->size = 0;
@@ -346,4 +912,113 @@ int inode_trunc_data(const char *image_path, struct inode *in) {
     in->mtime = in->atime = now;
 
     return 0;
-}
\ No newline at end of file
+}
+
+// Versiones por image_path, se mantienen por compatibilidad
+
+int read_inode(const char *image_path, uint32_t inode_number, struct inode *in) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDONLY) != 0)
+        return -1;
+
+    int ret = dev_read_inode(&dev, inode_number, in);
+    vfs_close(&dev);
+    return ret;
+}
+
+int write_inode(const char *image_path, uint32_t inode_number, const struct inode *in) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_write_inode(&dev, inode_number, in);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
+
+int free_inode(const char *image_path, uint32_t inode_number) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_free_inode(&dev, inode_number);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
+
+int read_inodes(const char *image_path, uint32_t first, uint32_t count, struct inode *out) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDONLY) != 0)
+        return -1;
+
+    int ret = dev_read_inodes(&dev, first, count, out);
+    vfs_close(&dev);
+    return ret;
+}
+
+int get_block_number_at(const char *image_path, struct inode *in, uint16_t index) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDONLY) != 0)
+        return -1;
+
+    int ret = dev_get_block_number_at(&dev, in, index);
+    vfs_close(&dev);
+    return ret;
+}
+
+int create_empty_file_in_free_inode(const char *image_path, uint16_t perms) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_create_empty_file_in_free_inode(&dev, perms);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
+
+int inode_append_block(const char *image_path, struct inode *in, uint32_t new_block_number) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_inode_append_block(&dev, in, new_block_number);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
+
+int inode_map_extent(const char *image_path, struct inode *in, uint32_t logical, uint32_t start, uint32_t count) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_inode_map_extent(&dev, in, logical, start, count);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
+
+int inode_append_extent(const char *image_path, struct inode *in, uint32_t start, uint32_t count) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_inode_append_extent(&dev, in, start, count);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
+
+int inode_trunc_data(const char *image_path, struct inode *in) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_inode_trunc_data(&dev, in);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
@@ -35,22 +35,41 @@ const char *str_file_permissions(uint16_t mode) {
 }
 
 // Retorna el usuario si existe, o de lo contrario el uid numerico
+// Recuerda el último uid: en un listado casi todos los archivos son del mismo usuario,
+// y cada getpwuid vuelve a leer la base de usuarios
 const char *str_user(uint16_t uid) {
     static char uidbuf[32];
+    static int cached = 0;
+    static uint16_t cached_uid;
+    if (cached && uid == cached_uid)
+        return uidbuf;
+
     struct passwd *pw = getpwuid(uid);
     if (pw)
-        return pw->pw_name;
-    snprintf(uidbuf, sizeof(uidbuf), "%u", uid);
+        snprintf(uidbuf, sizeof(uidbuf), "%s", pw->pw_name);
+    else
+        snprintf(uidbuf, sizeof(uidbuf), "%u", uid);
+    cached = 1;
+    cached_uid = uid;
     return uidbuf;
 }
 
 // Retorna el grupo si existe, o de lo contrario el gid numerico
+// Recuerda el último gid, igual que str_user
 const char *str_group(uint16_t gid) {
     static char gidbuf[32];
+    static int cached = 0;
+    static uint16_t cached_gid;
+    if (cached && gid == cached_gid)
+        return gidbuf;
+
     struct group *gr = getgrgid(gid);
     if (gr)
-        return gr->gr_name;
-    snprintf(gidbuf, sizeof(gidbuf), "%u", gid);
+        snprintf(gidbuf, sizeof(gidbuf), "%s", gr->gr_name);
+    else
+        snprintf(gidbuf, sizeof(gidbuf), "%u", gid);
+    cached = 1;
+    cached_gid = gid;
     return gidbuf;
 }
 
@@ -64,13 +83,22 @@ const char *str_group(uint16_t gid) {
 */
 void str_timestamp(uint32_t ts, char *buffer, size_t size) {
     DEBUG_PRINT("Entrando en str timestamp %u\n", ts);
+    // localtime vuelve a consultar la zona horaria en cada llamada; se lee una vez y se usa localtime_r
+    static int tz_ready = 0;
+    if (!tz_ready) {
+        tzset();
+        tz_ready = 1;
+    }
+
     time_t t = ts;
-    struct tm *tm_info = localtime(&t);
-    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", tm_info);
+    struct tm tm_info;
+    localtime_r(&t, &tm_info);
+    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &tm_info);
     return;
 }
 
-void print_inode(const struct inode *in, uint32_t inode_nbr, const char *filename) {
+void print_inode(const struct inode *in, uint32_t blocks, uint32_t inode_nbr, const char *filename) {
+    // blocks son los bloques de datos asignados, sin los huecos (dev_inode_allocated_blocks)
     char ctime_buf[32];
     char mtime_buf[32];
     char atime_buf[32];
@@ -79,7 +107,7 @@ void print_inode(const struct inode *in, uint32_t inode_nbr, const char *filenam
     str_timestamp(in->atime, atime_buf, sizeof(atime_buf));
 
     printf("%4u %s%s %-10s %-10s %3u %8u %s %s %s %s\n", inode_nbr, str_file_type(in->mode),
-           str_file_permissions(in->mode), str_user(in->uid), str_group(in->gid), in->blocks, in->size, ctime_buf,
+           str_file_permissions(in->mode), str_user(in->uid), str_group(in->gid), blocks, in->size, ctime_buf,
            mtime_buf, atime_buf, filename);
 }
 
@@ -96,139 +124,308 @@ int name_is_valid(const char *name) {
     return 1;
 }
 
-int dir_lookup(const char *image_path, const char *filename) {
-    // No valida que el nombre sea válido ni que la imagen lo sea
-    // Retorna nodo-I encontrado para la entrada,
-    // retorna 0 (nodo-I invalido) si no lo encuentra, o -1 en caso de errores
+static int dir_linear_lookup(struct vfs_device *dev, const struct inode *root, const char *filename, uint32_t *block,
+                             uint32_t *slot) {
+    // Busca filename recorriendo todas las entradas del directorio, y deja en *block y *slot su bloque y posición
+    // Cada bloque se compara completo contra la clave con dir_block_scan
+    // Retorna el nodo-I de la entrada, 0 si no la encuentra, o -1 en caso de error
+    struct dir_entry key;
+    dir_key_init(&key, filename);
+
+    struct bmap_cursor cur;
+    bmap_cursor_init(&cur, root, 0);
+    uint32_t start, count;
+    int r;
+    while ((r = dev_bmap_next(dev, &cur, UINT32_MAX, &start, &count)) == 1) {
+        if (start == 0)
+            continue; // un hueco no tiene entradas: dev_read_block leería el superbloque
+
+        uint32_t logical = cur.index - count;
+        for (uint32_t block_num = start; block_num < start + count; block_num++) {
+            uint8_t data_buf[BLOCK_SIZE];
+            if (dev_read_block(dev, block_num, data_buf) != 0) {
+                fprintf(stderr, "Error al leer el bloque %u: %s\n", block_num, strerror(errno));
+                return -1;
+            }
 
-    struct inode root_inode;
+            struct dir_entry *entries = (struct dir_entry *)data_buf;
 
-    // Leer el nodo-I de la raiz, bien conocida
-    if (read_inode(image_path, ROOTDIR_INODE, &root_inode) != 0) {
+            uint32_t match, free_mask;
+            dir_block_scan(entries, &key, &match, &free_mask);
+            if (match != 0) {
+                uint32_t j = (uint32_t)__builtin_ctz(match);
+                *block = block_num;
+                *slot = (logical + block_num - start) * DIR_ENTRIES_PER_BLOCK + j;
+                return entries[j].inode;
+            }
+        }
+    }
+
+    if (r < 0) {
+        fprintf(stderr, "Error inesperado el buscar bloque %u del directorio raiz.\n", cur.index);
         return -1;
     }
 
-    // recorre todos sus bloques de datos para buscar filename
-    for (uint16_t i = 0; i < root_inode.blocks; i++) {
+    return 0; // No encontrado
+}
 
-        int block_num = get_block_number_at(image_path, &root_inode, i);
-        if (block_num <= 0) {
-            fprintf(stderr, "Error inesperado el buscar bloque %d del directorio raiz.\n", i);
-            return -1;
-        }
+static int dir_find_name(struct vfs_device *dev, const char *filename, uint32_t *block, uint32_t *slot) {
+    // Busca filename en la cache de entradas y, si no sabe la respuesta, en el directorio raíz: con su
+    // índice si lo tiene, o si no cargando en la cache el directorio completo (o recorriéndolo sin cache)
+    // Retorna el nodo-I de la entrada y su bloque y posición en *block y *slot, 0 si no la encuentra,
+    // o -1 en caso de error
+    uint32_t inode_number;
+    if (dcache_lookup(dev, filename, &inode_number, block, slot))
+        return (int)inode_number;
+
+    struct inode root;
+    if (dev_read_inode(dev, ROOTDIR_INODE, &root) != 0)
+        return -1;
 
-        uint8_t data_buf[BLOCK_SIZE];
-        if (read_block(image_path, block_num, data_buf) != 0) {
-            return -1;
+    if (!(root.mode & INODE_MODE_INDEXED)) {
+        if (dev->dcache) {
+            if (dcache_fill(dev, &root) != 0)
+                return -1;
+            if (dcache_lookup(dev, filename, &inode_number, block, slot))
+                return (int)inode_number;
+            // sin memoria para la cache: se recorre el directorio como siempre
         }
+        return dir_linear_lookup(dev, &root, filename, block, slot);
+    }
 
-        struct dir_entry *entries = (struct dir_entry *)data_buf;
+    int found = dev_dir_index_lookup(dev, &root, filename, slot);
+    if (found > 0) {
+        int block_num = dev_get_block_number_at(dev, &root, (uint16_t)(*slot / DIR_ENTRIES_PER_BLOCK));
+        if (block_num <= 0)
+            return -1;
+        *block = (uint32_t)block_num;
+    }
+    if (found >= 0)
+        dcache_update(dev, filename, (uint32_t)found, found > 0 ? *block : 0, found > 0 ? *slot : 0);
+    return found;
+}
 
-        for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
-            if (entries[j].inode == 0)
-                continue;
+int dev_dir_lookup(struct vfs_device *dev, const char *filename) {
+    // No valida que el nombre sea válido ni que la imagen lo sea
+    // Retorna nodo-I encontrado para la entrada,
+    // retorna 0 (nodo-I invalido) si no lo encuentra, o -1 en caso de errores
+    uint32_t block, slot;
+    return dir_find_name(dev, filename, &block, &slot);
+}
 
-            if (strncmp(entries[j].name, filename, FILENAME_MAX_LEN) == 0) {
-                return entries[j].inode;
+static int dir_find_free(struct vfs_device *dev, const struct inode *root, uint32_t from, uint32_t *block_num,
+                         uint32_t *slot, uint8_t *data_buf) {
+    // Busca la primera entrada libre del directorio a partir de la entrada from
+    // Deja en *block_num el bloque que la contiene, leído en data_buf, y en *slot su posición en el directorio
+    // Retorna 1 si la encontró, 0 si no hay entradas libres desde from, o -1 en caso de error
+    struct bmap_cursor cur;
+    bmap_cursor_init(&cur, root, from / DIR_ENTRIES_PER_BLOCK);
+    uint32_t start, count;
+    int r;
+    while ((r = dev_bmap_next(dev, &cur, UINT32_MAX, &start, &count)) == 1) {
+        if (start == 0)
+            continue; // un directorio no tiene huecos, pero no hay nada que buscar en ellos
+
+        uint32_t logical = cur.index - count;
+        for (uint32_t k = 0; k < count; k++) {
+            if (dev_read_block(dev, start + k, data_buf) != 0)
+                return -1;
+
+            struct dir_entry *entries = (struct dir_entry *)data_buf;
+            uint32_t first = (logical + k) * DIR_ENTRIES_PER_BLOCK;
+            uint32_t match, free_mask;
+            dir_block_scan(entries, NULL, &match, &free_mask);
+            if (from > first)
+                free_mask &= ~0u << (from - first); // entradas anteriores a from
+            if (free_mask != 0) {
+                *block_num = start + k;
+                *slot = first + (uint32_t)__builtin_ctz(free_mask);
+                return 1;
             }
         }
     }
 
-    return 0; // No encontrado
+    if (r < 0) {
+        fprintf(stderr, "Error inesperado el buscar bloque %u del directorio raiz.\n", cur.index);
+        return -1;
+    }
+    return 0;
 }
 
-int add_dir_entry(const char *image_path, const char *filename, uint32_t inode_number) {
+static int dir_grow(struct vfs_device *dev, struct inode *root) {
+    // Agrega bloques en cero al final del directorio raíz: el doble de los que tiene, hasta VFS_DIR_GROW_BLOCKS
+    // Los bloques se escriben con dev_inode_write_data, que los pide contiguos a los anteriores y los
+    // escribe completos: un bloque liberado sin llenar con ceros (VFS_ZERO lazy) no deja entradas viejas
+    // Actualiza *root. Retorna 0 o -1 (errno ENOSPC si el directorio no puede crecer más)
+    uint32_t grow = root->blocks < VFS_DIR_GROW_BLOCKS ? root->blocks : VFS_DIR_GROW_BLOCKS;
+    if (grow == 0)
+        grow = 1;
+    uint32_t max_blocks = inode_max_blocks(root);
+    if (root->blocks + grow > max_blocks)
+        grow = max_blocks - root->blocks;
+    if (grow == 0) {
+        fprintf(stderr, "Error: el directorio raíz llegó a su tamaño máximo (%u bloques)\n", max_blocks);
+        errno = ENOSPC;
+        return -1;
+    }
+
+    uint8_t *zero_buf = calloc(grow, BLOCK_SIZE);
+    if (!zero_buf)
+        return -1;
+
+    DEBUG_PRINT("Agregando %u bloques al directorio raiz, que tiene %u.\n", grow, root->blocks);
+    size_t len = (size_t)grow * BLOCK_SIZE;
+    int written = dev_inode_write_data(dev, ROOTDIR_INODE, zero_buf, len, root->size);
+    free(zero_buf);
+    if (written != (int)len)
+        return -1;
+
+    return dev_read_inode(dev, ROOTDIR_INODE, root);
+}
+
+int dev_add_dir_entry(struct vfs_device *dev, const char *filename, uint32_t inode_number) {
     // No valida el nro de inodo
+    // La búsqueda de una entrada libre empieza en sb->dir_hint; si el directorio está lleno, crece
 
     if (!name_is_valid(filename)) {
         DEBUG_PRINT("Nombre de archivo %s no es valido para agregarlo al directorio.\n", filename);
         return -1;
     }
-    
-    struct inode root_inode;
 
-    if (read_inode(image_path, ROOTDIR_INODE, &root_inode) != 0)
+    struct superblock sb_struct, *sb = &sb_struct;
+    if (dev_read_superblock(dev, sb) != 0)
         return -1;
 
-    for (int i = 0; i < root_inode.blocks; i++) {
-
-        int block_num = get_block_number_at(image_path, &root_inode, i);
-        if (block_num <= 0) {
-            fprintf(stderr, "Error inesperado el buscar bloque %d del directorio raiz.\n", i);
-            return -1;
-        }
+    struct inode root_inode;
+    if (dev_read_inode(dev, ROOTDIR_INODE, &root_inode) != 0)
+        return -1;
 
-        uint8_t data_buf[BLOCK_SIZE];
-        if (read_block(image_path, block_num, data_buf) != 0)
+    uint8_t data_buf[BLOCK_SIZE];
+    uint32_t block_num, slot;
+    int r = dir_find_free(dev, &root_inode, sb->dir_hint, &block_num, &slot, data_buf);
+    if (r == 0) {
+        uint32_t from = root_inode.blocks * DIR_ENTRIES_PER_BLOCK;
+        if (dir_grow(dev, &root_inode) != 0)
             return -1;
+        r = dir_find_free(dev, &root_inode, from, &block_num, &slot, data_buf);
+    }
+    if (r < 0)
+        return -1;
+    if (r == 0) {
+        errno = ENOSPC; // no debería pasar: el directorio acaba de crecer
+        return -1;
+    }
 
-        struct dir_entry *entries = (struct dir_entry *)data_buf;
-
-        for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
-            if (entries[j].inode == 0) {
-                entries[j].inode = inode_number;
-                strncpy(entries[j].name, filename, FILENAME_MAX_LEN);
-                DEBUG_PRINT("Escribiendo entry %s %u en blocknum %d.\n", filename, inode_number, block_num);
+    struct dir_entry *entry = (struct dir_entry *)data_buf + slot % DIR_ENTRIES_PER_BLOCK;
+    dir_key_init(entry, filename); // el nombre completado con ceros, como lo compara dir_block_scan
+    entry->inode = inode_number;
+    DEBUG_PRINT("Escribiendo entry %s %u en blocknum %u.\n", filename, inode_number, block_num);
 
-                if (write_block(image_path, block_num, data_buf) != 0)
-                    return -1;
+    if (dev_write_block(dev, block_num, data_buf) != 0)
+        return -1;
 
-                return 0; // OK
-            }
-        }
+    if ((root_inode.mode & INODE_MODE_INDEXED) && dev_dir_index_insert(dev, &root_inode, filename, slot) != 0) {
+        fprintf(stderr, "Error al actualizar el índice del directorio\n");
+        return -1;
     }
+    dcache_update(dev, filename, inode_number, block_num, slot);
 
-    // No se encontró una entrada libre
-    errno = ENOSPC;
-    return -1;
+    // Todas las entradas anteriores a la usada siguen ocupadas; dir_grow pudo cambiar el superbloque
+    if (dev_read_superblock(dev, sb) != 0)
+        return -1;
+    sb->dir_hint = slot + 1;
+    return dev_write_superblock(dev, sb);
 }
 
-int remove_dir_entry(const char *image_path, const char *filename) {
+int dev_remove_dir_entry(struct vfs_device *dev, const char *filename) {
     // elimina logicamente una entrada de directorio, escribiendo ceros en ella
     // busca la entrada por el nombre del filename
     // Retorna 0 si se eliminó o no estaba, -1 en caso de error
 
     struct inode root_inode;
 
-    if (read_inode(image_path, ROOTDIR_INODE, &root_inode) != 0) {
+    if (dev_read_inode(dev, ROOTDIR_INODE, &root_inode) != 0) {
         return -1;
     }
 
-    for (uint16_t i = 0; i < root_inode.blocks; i++) {
+    uint32_t block_num, slot;
+    int inode_number = dir_find_name(dev, filename, &block_num, &slot);
+    if (inode_number < 0)
+        return -1;
+    if (inode_number == 0) {
+        DEBUG_PRINT("Archivo '%s' no estaba en el directorio\n", filename);
+        return 0; // No encontrado, pero no es error
+    }
 
-        int block_num = get_block_number_at(image_path, &root_inode, i);
-        if (block_num <= 0) {
-            fprintf(stderr, "Error inesperado el buscar bloque %d del directorio raiz.\n", i);
-            return -1;
-        }
+    uint8_t data_buf[BLOCK_SIZE];
+    if (dev_read_block(dev, block_num, data_buf) != 0) {
+        fprintf(stderr, "Error al leer el bloque %u: %s\n", block_num, strerror(errno));
+        return -1;
+    }
 
-        uint8_t data_buf[BLOCK_SIZE];
-        if (read_block(image_path, block_num, data_buf) != 0) {
-            fprintf(stderr, "Error al leer el bloque %d: %s\n", block_num, strerror(errno));
-            return -1;
-        }
+    struct dir_entry *entry = (struct dir_entry *)data_buf + slot % DIR_ENTRIES_PER_BLOCK;
+    if (entry->inode != (uint32_t)inode_number || strncmp(entry->name, filename, FILENAME_MAX_LEN) != 0) {
+        fprintf(stderr, "Error: la entrada %u del directorio no es la de '%s'\n", slot, filename);
+        return -1;
+    }
+    DEBUG_PRINT("Eliminando entrada de directorio '%s' (inode %u) en bloque %u, pos %u\n", filename, entry->inode,
+                block_num, slot % DIR_ENTRIES_PER_BLOCK);
 
-        struct dir_entry *entries = (struct dir_entry *)data_buf;
+    entry->inode = 0;
+    memset(entry->name, 0, FILENAME_MAX_LEN);
 
-        for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
-            if (entries[j].inode != 0 && strncmp(entries[j].name, filename, FILENAME_MAX_LEN) == 0) {
+    if (dev_write_block(dev, block_num, data_buf) != 0) {
+        fprintf(stderr, "Error al escribir bloque de directorio actualizado\n");
+        return -1;
+    }
 
-                DEBUG_PRINT("Eliminando entrada de directorio '%s' (inode %u) en bloque %d, pos %u\n", filename,
-                            entries[j].inode, block_num, j);
+    if ((root_inode.mode & INODE_MODE_INDEXED) && dev_dir_index_remove(dev, &root_inode, filename, slot) != 0) {
+        fprintf(stderr, "Error al actualizar el índice del directorio\n");
+        return -1;
+    }
+    dcache_update(dev, filename, 0, 0, 0);
 
-                entries[j].inode = 0;
-                memset(entries[j].name, 0, FILENAME_MAX_LEN);
+    // La entrada liberada es la próxima a usar si está antes de la pista
+    struct superblock sb_struct, *sb = &sb_struct;
+    if (dev_read_superblock(dev, sb) != 0)
+        return -1;
+    if (slot < sb->dir_hint) {
+        sb->dir_hint = slot;
+        return dev_write_superblock(dev, sb);
+    }
+    return 0;
+}
 
-                if (write_block(image_path, block_num, data_buf) != 0) {
-                    fprintf(stderr, "Error al escribir bloque de directorio actualizado\n");
-                    return -1;
-                }
+// Versiones por image_path, se mantienen por compatibilidad
 
-                return 0;
-            }
-        }
-    }
+int dir_lookup(const char *image_path, const char *filename) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDONLY) != 0)
+        return -1;
+
+    int ret = dev_dir_lookup(&dev, filename);
+    vfs_close(&dev);
+    return ret;
+}
+
+int add_dir_entry(const char *image_path, const char *filename, uint32_t inode_number) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_add_dir_entry(&dev, filename, inode_number);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
+
+int remove_dir_entry(const char *image_path, const char *filename) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
 
-    DEBUG_PRINT("Archivo '%s' no estaba en el directorio\n", filename);
-    return 0; // No encontrado, pero no es error
+    int ret = dev_remove_dir_entry(&dev, filename);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
 }
@@ -1,10 +1,22 @@
 // read-write-block.c
 
+#ifdef __linux__
+#define _GNU_SOURCE // fallocate
+#endif
+
 #include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "vfs.h"
@@ -12,59 +24,656 @@
 /*
     Estas son las funciones de "mas bajo nivel"
     No escriben nada en caso de error, se supone que los invocadores lo controlan
+
+    La imagen se abre una sola vez por comando con vfs_open(), y todas las
+    funciones dev_xxx usan ese mismo descriptor con pread/pwrite.
+    Las funciones que reciben image_path se mantienen por compatibilidad:
+    abren la imagen, invocan a la version dev_xxx y la cierran.
+
+    dev_read_block/dev_write_block pasan por la cache de bloques (block-cache.c);
+    dev_io_read/dev_io_write son el acceso real a la imagen, sin cache.
+    Los nodos-I pasan por su propia cache (inode-cache.c), salvo con VFS_INODE_CACHE=0.
+    dev_read_blocks/dev_write_blocks mueven varios bloques por llamada: agrupan los
+    bloques fisicamente contiguos en corridas y hacen un preadv/pwritev por corrida.
+    Los bloques modificados llegan a la imagen recien con vfs_flush() o vfs_close().
+
+    El acceso real se elige con la variable de entorno VFS_IO:
+        pread   (por defecto) pread/pwrite sobre el descriptor
+        mmap    la imagen completa se mapea solo lectura y las lecturas son un memcpy;
+                las escrituras siguen usando pwrite
+        mmap-rw la imagen se mapea lectura/escritura, las escrituras son un memcpy
+                y vfs_flush() hace msync
+        uring   las corridas de dev_read_blocks/dev_write_blocks y de vfs_flush() se
+                envian juntas con io_uring (uring.c), con hasta VFS_QUEUE_DEPTH pedidos
+                en vuelo; si io_uring no esta disponible se usa pread
+    Con mmap la cache de bloques no se usa: el mapeo ya cumple esa funcion.
+
+    VFS_ZERO=eager|lazy|punch elige si los bloques liberados se llenan con ceros,
+    ver dev_bitmap_free_blocks(); por defecto se respeta la opcion del superbloque.
+
+    VFS_ATIME=strict|relatime|noatime elige cuando una lectura actualiza atime, ver
+    dev_inode_read_data(); por defecto se respeta la opcion del superbloque.
 */
 
-int read_block(const char *image_path, int block_number, void *buffer) {
-    int fd = open(image_path, O_RDONLY);
+static int env_io_mode(void) {
+    // Modo de acceso a la imagen, configurable con la variable de entorno VFS_IO
+    const char *value = getenv(VFS_ENV_IO);
+    if (!value || *value == '\0' || strcmp(value, "pread") == 0)
+        return VFS_IO_PREAD;
+    if (strcmp(value, "mmap") == 0)
+        return VFS_IO_MMAP;
+    if (strcmp(value, "mmap-rw") == 0)
+        return VFS_IO_MMAP_RW;
+    if (strcmp(value, "uring") == 0)
+        return VFS_IO_URING;
+
+    fprintf(stderr, "Advertencia: %s=%s inválido, se usa pread\n", VFS_ENV_IO, value);
+    return VFS_IO_PREAD;
+}
+
+static int env_zero_mode(void) {
+    // Tratamiento de los bloques liberados, configurable con la variable de entorno VFS_ZERO
+    const char *value = getenv(VFS_ENV_ZERO);
+    if (!value || *value == '\0')
+        return VFS_ZERO_DEFAULT;
+    if (strcmp(value, "eager") == 0)
+        return VFS_ZERO_EAGER;
+    if (strcmp(value, "lazy") == 0)
+        return VFS_ZERO_LAZY;
+    if (strcmp(value, "punch") == 0)
+        return VFS_ZERO_PUNCH;
+
+    fprintf(stderr, "Advertencia: %s=%s inválido, se usa el valor del superbloque\n", VFS_ENV_ZERO, value);
+    return VFS_ZERO_DEFAULT;
+}
+
+static int env_atime_mode(void) {
+    // Actualización de atime en las lecturas, configurable con la variable de entorno VFS_ATIME
+    const char *value = getenv(VFS_ENV_ATIME);
+    if (!value || *value == '\0')
+        return VFS_ATIME_DEFAULT;
+    if (strcmp(value, "strict") == 0)
+        return VFS_ATIME_STRICT;
+    if (strcmp(value, "relatime") == 0)
+        return VFS_ATIME_RELATIME;
+    if (strcmp(value, "noatime") == 0)
+        return VFS_ATIME_NOATIME;
+
+    fprintf(stderr, "Advertencia: %s=%s inválido, se usa el valor del superbloque\n", VFS_ENV_ATIME, value);
+    return VFS_ATIME_DEFAULT;
+}
+
+static int io_map(struct vfs_device *dev) {
+    // Mapea la imagen completa en memoria según dev->io_mode
+    // Retorna 0 o -1 en caso de error
+    struct stat st;
+    if (fstat(dev->fd, &st) != 0)
+        return -1;
+
+    if (st.st_size < BLOCK_SIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int prot = PROT_READ;
+    if (dev->io_mode == VFS_IO_MMAP_RW) {
+        if (dev->mode != VFS_OPEN_RDWR)
+            dev->io_mode = VFS_IO_MMAP; // no se puede mapear para escritura una imagen abierta solo lectura
+        else
+            prot |= PROT_WRITE;
+    }
+
+    void *map = mmap(NULL, st.st_size, prot, MAP_SHARED, dev->fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+
+    dev->map = map;
+    dev->map_size = st.st_size;
+    return 0;
+}
+
+static int io_unmap(struct vfs_device *dev) {
+    if (!dev->map)
+        return 0;
+
+    int ret = munmap(dev->map, dev->map_size);
+    dev->map = NULL;
+    dev->map_size = 0;
+    return ret;
+}
+
+static uint32_t env_uint(const char *name, uint32_t default_value, uint32_t max_value) {
+    // Valor numérico de la variable de entorno name, o default_value si no está definida o es inválida
+    const char *value = getenv(name);
+    if (!value || *value == '\0')
+        return default_value;
+
+    char *end;
+    long number = strtol(value, &end, 10);
+    if (*end != '\0' || number < 0) {
+        fprintf(stderr, "Advertencia: %s=%s inválido, se usa %u\n", name, value, default_value);
+        return default_value;
+    }
+
+    return number > (long)max_value ? max_value : (uint32_t)number;
+}
+
+int vfs_open(struct vfs_device *dev, const char *image_path, int mode) {
+    // "Monta" la imagen: la abre y deja el descriptor en dev
+    // Retorna 0 en éxito, -1 en error (con errno seteado por open)
+
+    memset(dev, 0, sizeof(struct vfs_device));
+
+    int fd = open(image_path, mode == VFS_OPEN_RDWR ? O_RDWR : O_RDONLY);
     if (fd < 0)
         return -1;
 
-    if (lseek(fd, block_number * BLOCK_SIZE, SEEK_SET) < 0) {
+    dev->fd = fd;
+    dev->mode = mode;
+    dev->image_path = image_path;
+    dev->io_mode = env_io_mode();
+    dev->zero_mode = env_zero_mode();
+    dev->atime_mode = env_atime_mode();
+
+    // Solo los modos mmap mapean la imagen: dev_io_read lee del mapeo siempre que exista
+    if (dev->io_mode == VFS_IO_MMAP || dev->io_mode == VFS_IO_MMAP_RW) {
+        if (io_map(dev) != 0) {
+            DEBUG_PRINT("No se pudo mapear %s (%s), se usa pread\n", image_path, strerror(errno));
+            io_unmap(dev);
+            dev->io_mode = VFS_IO_PREAD;
+        }
+    }
+
+    if (dev->io_mode == VFS_IO_URING) {
+        uint32_t depth = env_uint(VFS_ENV_QUEUE_DEPTH, VFS_QUEUE_DEFAULT_DEPTH, VFS_MAX_IO_BLOCKS);
+        if (depth == 0)
+            depth = 1;
+        if (uring_init(dev, depth) != 0) {
+            fprintf(stderr, "Advertencia: io_uring no disponible (%s), se usa pread\n", strerror(errno));
+            uring_free(dev);
+            io_unmap(dev);
+            dev->io_mode = VFS_IO_PREAD;
+        }
+    }
+
+    uint32_t cache_blocks = 0;
+    if (dev->io_mode == VFS_IO_PREAD || dev->io_mode == VFS_IO_URING)
+        cache_blocks = env_uint(VFS_ENV_CACHE_BLOCKS, VFS_CACHE_DEFAULT_BLOCKS, VFS_MAX_BLOCKS);
+    if (cache_init(dev, cache_blocks) != 0 || icache_init(dev, env_uint(VFS_ENV_INODE_CACHE, 1, 1)) != 0 ||
+        dcache_init(dev, env_uint(VFS_ENV_DENTRY_CACHE, 1, 1)) != 0) {
+        icache_free(dev);
+        cache_free(dev);
+        uring_free(dev);
+        io_unmap(dev);
         close(fd);
+        dev->fd = -1;
         return -1;
     }
 
-    if (read(fd, buffer, BLOCK_SIZE) != BLOCK_SIZE) {
-        close(fd);
+    return 0;
+}
+
+int vfs_flush(struct vfs_device *dev) {
+    // Escribe a la imagen todo lo que esté pendiente en memoria
+    // Retorna 0 en éxito, -1 en error
+    int ret = icache_flush(dev);
+    if (cache_flush(dev) != 0)
+        ret = -1;
+
+    if (dev->map_dirty) {
+        if (msync(dev->map, dev->map_size, MS_SYNC) != 0)
+            ret = -1;
+        else
+            dev->map_dirty = 0;
+    }
+
+    return ret;
+}
+
+int vfs_close(struct vfs_device *dev) {
+    // Escribe lo pendiente y cierra la imagen. Retorna 0 en éxito, -1 en error
+    if (dev->fd < 0)
+        return 0;
+
+    int ret = vfs_flush(dev);
+
+    if (getenv(VFS_ENV_STATS))
+        vfs_print_stats(dev);
+
+    dcache_free(dev);
+    icache_free(dev);
+    cache_free(dev);
+    uring_free(dev);
+
+    if (io_unmap(dev) != 0)
+        ret = -1;
+
+    if (close(dev->fd) != 0)
+        ret = -1;
+    dev->fd = -1;
+    return ret;
+}
+
+void vfs_print_stats(const struct vfs_device *dev) {
+    // Muestra por stderr los contadores de acceso a la imagen
+    const struct vfs_stats *st = &dev->stats;
+    fprintf(stderr, "vfs stats %s: reads %llu, writes %llu, cache hits %llu, misses %llu, evictions %llu, "
+                    "writebacks %llu\n",
+            dev->image_path, (unsigned long long)st->reads, (unsigned long long)st->writes,
+            (unsigned long long)st->cache_hits, (unsigned long long)st->cache_misses,
+            (unsigned long long)st->cache_evictions, (unsigned long long)st->cache_writebacks);
+
+    if (dev->icache) {
+        fprintf(stderr, "vfs stats %s: inode cache hits %llu, misses %llu, table blocks read %llu, written %llu\n",
+                dev->image_path, (unsigned long long)st->icache_hits, (unsigned long long)st->icache_misses,
+                (unsigned long long)st->icache_loads, (unsigned long long)st->icache_writebacks);
+    }
+
+    if (dev->dcache) {
+        fprintf(stderr, "vfs stats %s: dentry cache hits %llu, negative %llu, misses %llu, directory scans %llu\n",
+                dev->image_path, (unsigned long long)st->dcache_hits, (unsigned long long)st->dcache_negative,
+                (unsigned long long)st->dcache_misses, (unsigned long long)st->dcache_scans);
+    }
+
+    double seconds = st->batch_ns / 1e9;
+    double mib = (st->bytes_read + st->bytes_written) / (1024.0 * 1024.0);
+    fprintf(stderr, "vfs stats %s: %llu KiB read, %llu KiB written, batched I/O %.3f ms (%.1f MiB/s)\n",
+            dev->image_path, (unsigned long long)(st->bytes_read / 1024), (unsigned long long)(st->bytes_written / 1024),
+            seconds * 1e3, seconds > 0 ? mib / seconds : 0.0);
+
+    if (dev->io_mode == VFS_IO_URING && st->uring_enters > 0) {
+        fprintf(stderr, "vfs stats %s: io_uring enters %llu, queue depth max %llu, avg %.1f\n", dev->image_path,
+                (unsigned long long)st->uring_enters, (unsigned long long)st->uring_max_inflight,
+                (double)st->uring_inflight_sum / st->uring_enters);
+    }
+}
+
+int dev_io_read(struct vfs_device *dev, uint32_t block_number, void *buffer) {
+    // Lectura real de un bloque de la imagen, sin pasar por la cache
+    off_t offset = (off_t)block_number * BLOCK_SIZE;
+
+    if (dev->map) {
+        if ((size_t)offset + BLOCK_SIZE > dev->map_size) {
+            errno = EINVAL;
+            return -1;
+        }
+        memcpy(buffer, dev->map + offset, BLOCK_SIZE);
+        return 0;
+    }
+
+    dev->stats.reads++;
+    if (pread(dev->fd, buffer, BLOCK_SIZE, offset) != BLOCK_SIZE)
         return -1;
+
+    dev->stats.bytes_read += BLOCK_SIZE;
+    return 0;
+}
+
+int dev_io_write(struct vfs_device *dev, uint32_t block_number, const void *buffer) {
+    // Escritura real de un bloque en la imagen, sin pasar por la cache
+    off_t offset = (off_t)block_number * BLOCK_SIZE;
+
+    if (dev->io_mode == VFS_IO_MMAP_RW) {
+        if ((size_t)offset + BLOCK_SIZE > dev->map_size) {
+            errno = EINVAL;
+            return -1;
+        }
+        memcpy(dev->map + offset, buffer, BLOCK_SIZE);
+        dev->map_dirty = 1;
+        return 0;
     }
 
-    close(fd);
+    dev->stats.writes++;
+    if (pwrite(dev->fd, buffer, BLOCK_SIZE, offset) != BLOCK_SIZE)
+        return -1;
+
+    dev->stats.bytes_written += BLOCK_SIZE;
     return 0;
 }
 
-int write_block(const char *image_path, int block_number, const void *buffer) {
-    int fd = open(image_path, O_WRONLY);
-    if (fd < 0)
+int dev_io_readv(struct vfs_device *dev, uint32_t first_block, const struct iovec *iov, int iovcnt) {
+    // Lectura real de iovcnt bloques contiguos a partir de first_block, sin pasar por la cache
+    // Cada iov[i] debe tener BLOCK_SIZE bytes
+    off_t offset = (off_t)first_block * BLOCK_SIZE;
+    size_t total = (size_t)iovcnt * BLOCK_SIZE;
+
+    if (dev->map) {
+        if ((size_t)offset + total > dev->map_size) {
+            errno = EINVAL;
+            return -1;
+        }
+        for (int i = 0; i < iovcnt; i++)
+            memcpy(iov[i].iov_base, dev->map + offset + (off_t)i * BLOCK_SIZE, BLOCK_SIZE);
+        dev->stats.bytes_read += total;
+        return 0;
+    }
+
+    dev->stats.reads++;
+    if (preadv(dev->fd, iov, iovcnt, offset) != (ssize_t)total)
         return -1;
 
-    if (lseek(fd, block_number * BLOCK_SIZE, SEEK_SET) < 0) {
-        close(fd);
+    dev->stats.bytes_read += total;
+    return 0;
+}
+
+int dev_io_writev(struct vfs_device *dev, uint32_t first_block, const struct iovec *iov, int iovcnt) {
+    // Escritura real de iovcnt bloques contiguos a partir de first_block, sin pasar por la cache
+    off_t offset = (off_t)first_block * BLOCK_SIZE;
+    size_t total = (size_t)iovcnt * BLOCK_SIZE;
+
+    if (dev->io_mode == VFS_IO_MMAP_RW) {
+        if ((size_t)offset + total > dev->map_size) {
+            errno = EINVAL;
+            return -1;
+        }
+        for (int i = 0; i < iovcnt; i++)
+            memcpy(dev->map + offset + (off_t)i * BLOCK_SIZE, iov[i].iov_base, BLOCK_SIZE);
+        dev->map_dirty = 1;
+        dev->stats.bytes_written += total;
+        return 0;
+    }
+
+    dev->stats.writes++;
+    if (pwritev(dev->fd, iov, iovcnt, offset) != (ssize_t)total)
         return -1;
+
+    dev->stats.bytes_written += total;
+    return 0;
+}
+
+int dev_io_submit(struct vfs_device *dev, int write, const struct io_run *runs, size_t count) {
+    // Ejecuta un lote de corridas de bloques contiguos, todas de lectura o todas de escritura
+    // Con io_uring se envían juntas; si no, se hace un preadv/pwritev por corrida
+    // Retorna 0 o -1 en caso de error
+    if (count == 0)
+        return 0;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int ret = 0;
+    if (dev->uring) {
+        ret = uring_submit_runs(dev, write, runs, count);
+    } else {
+        for (size_t i = 0; i < count && ret == 0; i++) {
+            if (write)
+                ret = dev_io_writev(dev, runs[i].block, runs[i].iov, runs[i].iovcnt);
+            else
+                ret = dev_io_readv(dev, runs[i].block, runs[i].iov, runs[i].iovcnt);
+        }
     }
 
-    if (write(fd, buffer, BLOCK_SIZE) != BLOCK_SIZE) {
-        close(fd);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    dev->stats.batch_ns += (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+    return ret;
+}
+
+int dev_io_punch(struct vfs_device *dev, uint32_t first_block, uint32_t count) {
+    // Libera en el archivo imagen el espacio de count bloques desde first_block, que
+    // a partir de ahí se leen como ceros (fallocate con FALLOC_FL_PUNCH_HOLE, solo Linux)
+    // Retorna 0, o -1 si no se pudo (errno EOPNOTSUPP si el sistema no lo soporta)
+    if (dev->mode != VFS_OPEN_RDWR) {
+        errno = EBADF;
         return -1;
     }
 
-    close(fd);
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+    off_t offset = (off_t)first_block * BLOCK_SIZE;
+    if (fallocate(dev->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, (off_t)count * BLOCK_SIZE) != 0)
+        return -1;
+
+    dev->stats.writes++;
     return 0;
+#else
+    (void)first_block;
+    (void)count;
+    errno = EOPNOTSUPP;
+    return -1;
+#endif
 }
 
-int create_block_device(const char *image_path, int total_blocks, int block_size) {
-    int fd = open(image_path, O_CREAT | O_EXCL | O_WRONLY, 0644);
-    if (fd < 0)
+int dev_io_send(struct vfs_device *dev, int out_fd, uint32_t first_block, size_t skip, size_t len, size_t *sent) {
+    // Copia len bytes de la imagen, desde el byte skip del bloque first_block, al descriptor out_fd
+    // sin pasar por un buffer del proceso: con sendfile (solo Linux), o con write desde el mapeo
+    // No pasa por la cache de bloques: los bloques sucios deben escribirse antes (cache_flush)
+    // Deja en *sent los bytes ya escritos en out_fd, también si falla a mitad de camino
+    // Retorna 0, o -1 (errno EINVAL o ENOSYS si out_fd o el sistema no lo permiten)
+    off_t offset = (off_t)first_block * BLOCK_SIZE + (off_t)skip;
+    *sent = 0;
+
+    if (dev->map) {
+        if ((size_t)offset + len > dev->map_size) {
+            errno = EINVAL;
+            return -1;
+        }
+        while (*sent < len) {
+            ssize_t n = write(out_fd, dev->map + offset + *sent, len - *sent);
+            if (n <= 0)
+                return -1;
+            *sent += (size_t)n;
+            dev->stats.bytes_read += (uint64_t)n;
+        }
+        return 0;
+    }
+
+#ifdef __linux__
+    while (*sent < len) {
+        dev->stats.reads++;
+        ssize_t n = sendfile(out_fd, dev->fd, &offset, len - *sent);
+        if (n <= 0) {
+            if (n == 0)
+                errno = EIO; // la imagen es más corta de lo esperado
+            return -1;
+        }
+        *sent += (size_t)n;
+        dev->stats.bytes_read += (uint64_t)n;
+    }
+    return 0;
+#else
+    (void)out_fd;
+    (void)offset;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int dev_io_advise(struct vfs_device *dev, uint32_t first_block, uint32_t count) {
+    // Avisa al sistema que se van a leer count bloques desde first_block, para que los traiga
+    // a memoria en segundo plano (posix_fadvise o madvise con WILLNEED). Es solo una sugerencia
+    // Retorna 0 o -1
+    off_t offset = (off_t)first_block * BLOCK_SIZE;
+    size_t len = (size_t)count * BLOCK_SIZE;
+
+    if (dev->map) {
+        if ((size_t)offset + len > dev->map_size) {
+            errno = EINVAL;
+            return -1;
+        }
+        // madvise necesita una dirección alineada a página
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t align = (size_t)offset % page;
+        return madvise(dev->map + offset - align, len + align, MADV_WILLNEED);
+    }
+
+    int err = posix_fadvise(dev->fd, offset, (off_t)len, POSIX_FADV_WILLNEED);
+    if (err != 0) {
+        errno = err;
         return -1;
+    }
+    return 0;
+}
+
+int dev_read_block(struct vfs_device *dev, int block_number, void *buffer) {
+    if (block_number < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (dev->cache)
+        return cache_read_block(dev, block_number, buffer);
+
+    return dev_io_read(dev, block_number, buffer);
+}
+
+int dev_write_block(struct vfs_device *dev, int block_number, const void *buffer) {
+    if (block_number < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (dev->mode != VFS_OPEN_RDWR) {
+        errno = EBADF;
+        return -1;
+    }
+
+    if (dev->cache)
+        return cache_write_block(dev, block_number, buffer);
+
+    return dev_io_write(dev, block_number, buffer);
+}
 
-    char zero[BLOCK_SIZE] = {0};
+int dev_read_blocks(struct vfs_device *dev, struct block_io *ios, size_t count) {
+    // Lee count bloques, cada uno en su buffer. Las entradas consecutivas de ios cuyos bloques
+    // son físicamente contiguos forman una corrida que se lee con un solo preadv; las corridas
+    // se ejecutan por lotes con dev_io_submit(). Los bloques que están en la cache se copian
+    // desde ahí, y los bloques leídos no se agregan a la cache.
+    // Retorna 0 o -1 en caso de error
+    struct iovec iov[VFS_MAX_IO_BLOCKS];
+    struct io_run runs[VFS_MAX_IO_BLOCKS];
+    size_t i = 0;
 
-    for (int i = 0; i < total_blocks; i++) {
-        if (write(fd, zero, block_size) != block_size) {
-            close(fd);
+    while (i < count) {
+        // Armar un lote de hasta VFS_MAX_IO_BLOCKS bloques
+        size_t nruns = 0;
+        int niov = 0;
+
+        while (i < count && niov < VFS_MAX_IO_BLOCKS) {
+            if (dev->cache && cache_peek(dev, ios[i].block, ios[i].buffer)) {
+                i++; // resuelto por la cache
+                continue;
+            }
+
+            if (nruns == 0 || ios[i].block != runs[nruns - 1].block + runs[nruns - 1].iovcnt) {
+                runs[nruns].block = ios[i].block;
+                runs[nruns].iov = &iov[niov];
+                runs[nruns].iovcnt = 0;
+                nruns++;
+            }
+
+            iov[niov].iov_base = ios[i].buffer;
+            iov[niov].iov_len = BLOCK_SIZE;
+            runs[nruns - 1].iovcnt++;
+            niov++;
+            i++;
+        }
+
+        if (dev_io_submit(dev, 0, runs, nruns) != 0)
             return -1;
+    }
+
+    return 0;
+}
+
+int dev_write_blocks(struct vfs_device *dev, const struct block_io *ios, size_t count) {
+    // Escribe count bloques, cada uno desde su buffer, con un pwritev por cada corrida
+    // de bloques físicamente contiguos; las corridas se ejecutan por lotes con dev_io_submit().
+    // Las escrituras van directo a la imagen; si algún bloque estaba en la cache se actualiza esa copia.
+    // Retorna 0 o -1 en caso de error
+    if (dev->mode != VFS_OPEN_RDWR) {
+        errno = EBADF;
+        return -1;
+    }
+
+    struct iovec iov[VFS_MAX_IO_BLOCKS];
+    struct io_run runs[VFS_MAX_IO_BLOCKS];
+    size_t i = 0;
+
+    while (i < count) {
+        size_t nruns = 0;
+        int niov = 0;
+
+        while (i < count && niov < VFS_MAX_IO_BLOCKS) {
+            if (dev->cache)
+                cache_update(dev, ios[i].block, ios[i].buffer);
+
+            if (nruns == 0 || ios[i].block != runs[nruns - 1].block + runs[nruns - 1].iovcnt) {
+                runs[nruns].block = ios[i].block;
+                runs[nruns].iov = &iov[niov];
+                runs[nruns].iovcnt = 0;
+                nruns++;
+            }
+
+            iov[niov].iov_base = ios[i].buffer;
+            iov[niov].iov_len = BLOCK_SIZE;
+            runs[nruns - 1].iovcnt++;
+            niov++;
+            i++;
         }
+
+        if (dev_io_submit(dev, 1, runs, nruns) != 0)
+            return -1;
     }
-    close(fd);
+
     return 0;
 }
+
+int read_block(const char *image_path, int block_number, void *buffer) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDONLY) != 0)
+        return -1;
+
+    int ret = dev_read_block(&dev, block_number, buffer);
+    vfs_close(&dev);
+    return ret;
+}
+
+int write_block(const char *image_path, int block_number, const void *buffer) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_write_block(&dev, block_number, buffer);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
+
+int read_blocks(const char *image_path, struct block_io *ios, size_t count) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDONLY) != 0)
+        return -1;
+
+    int ret = dev_read_blocks(&dev, ios, count);
+    vfs_close(&dev);
+    return ret;
+}
+
+int write_blocks(const char *image_path, const struct block_io *ios, size_t count) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_write_blocks(&dev, ios, count);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
+
+int create_block_device(const char *image_path, int total_blocks, int block_size) {
+    // Crea la imagen con total_blocks bloques en cero. Se extiende con ftruncate, sin
+    // escribir los bloques: el archivo queda disperso y el sistema de archivos devuelve
+    // ceros al leer las partes que nunca se escribieron
+    int fd = open(image_path, O_CREAT | O_EXCL | O_WRONLY, 0644);
+    if (fd < 0)
+        return -1;
+
+    if (ftruncate(fd, (off_t)total_blocks * block_size) != 0) {
+        int saved_errno = errno;
+        close(fd);
+        unlink(image_path);
+        errno = saved_errno;
+        return -1;
+    }
+
+    return close(fd);
+}
@@ -1,15 +1,121 @@
 // read-write-data.c
 
 #include <errno.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "vfs.h"
 
-int inode_write_data(const char *image_path, uint32_t inode_number, void *data_buf, size_t len, size_t offset) {
+static int inode_allocate_blocks(struct vfs_device *dev, struct inode *in, size_t required_blocks) {
+    // Agrega bloques al final del archivo hasta que tenga required_blocks bloques de datos
+    // Los bloques se piden al bitmap como corridas contiguas con dev_bitmap_alloc_extent, a partir
+    // del bloque siguiente al último del archivo, así el archivo queda seguido en la imagen;
+    // si hace falta el bloque indirecto, se ubica entre el último bloque directo y el primero indirecto.
+    // Cada corrida se agrega al nodo-I de una vez: en un nodo-I con extents suele quedar un solo extent
+    // Es responsabilidad del llamador escribir el nodo-I. Retorna 0 o -1
+    if (required_blocks <= in->blocks)
+        return 0;
+
+    size_t to_allocate = required_blocks - in->blocks;
+    if (!(in->mode & INODE_MODE_EXTENTS) && required_blocks > NUM_DIRECT_PTRS && in->indirect == 0)
+        to_allocate++; // bloque de punteros indirectos
+
+    struct superblock sb_struct, *sb = &sb_struct;
+    if (dev_read_superblock(dev, sb) != 0) {
+        fprintf(stderr, "Error al leer superblock\n");
+        return -1;
+    }
+
+    DEBUG_PRINT("required_blocks %zu to_allocate %zu.\n", required_blocks, to_allocate);
+
+    // Validar si hay suficientes bloques libres
+    if (to_allocate > sb->free_blocks) {
+        fprintf(stderr, "Error: No hay bloques libres suficientes (%zu requeridos)\n", to_allocate);
+        return -1;
+    }
+
+    // Pedir los bloques a continuación del último bloque del archivo; si está vacío,
+    // goal 0 deja que el bitmap use su pista de próxima asignación
+    uint32_t goal = 0;
+    if (in->blocks > 0) {
+        int last_block = dev_get_block_number_at(dev, in, in->blocks - 1);
+        if (last_block > 0)
+            goal = (uint32_t)last_block + 1;
+    }
+
+    while (to_allocate > 0) {
+        uint32_t start, count;
+        if (dev_bitmap_alloc_extent(dev, goal, (uint32_t)to_allocate, 1, &start, &count) != 0) {
+            fprintf(stderr, "Error al asignar bloques adicionales\n");
+            return -1;
+        }
+        DEBUG_PRINT("bloques adicionales %u a %u\n", start, start + count - 1);
+
+        uint32_t block = start, left = count;
+        while (left > 0) {
+            int pointers = !(in->mode & INODE_MODE_EXTENTS);
+            if (pointers && in->blocks >= NUM_DIRECT_PTRS && in->indirect == 0) {
+                // El bloque indirecto se inicializa con todos los punteros en 0
+                uint8_t zero_buf[BLOCK_SIZE] = {0};
+                if (dev_write_block(dev, block, zero_buf) != 0) {
+                    fprintf(stderr, "Error al inicializar el bloque indirecto %u\n", block);
+                    return -1;
+                }
+                in->indirect = block++;
+                left--;
+                continue;
+            }
+
+            uint32_t n = left;
+            if (pointers && in->blocks < NUM_DIRECT_PTRS && in->indirect == 0 && in->blocks + n > NUM_DIRECT_PTRS)
+                n = NUM_DIRECT_PTRS - in->blocks; // la corrida se corta donde va el bloque indirecto
+
+            if (dev_inode_append_extent(dev, in, block, n) != 0)
+                return -1;
+            block += n;
+            left -= n;
+        }
+
+        to_allocate -= count;
+        goal = start + count;
+    }
+
+    return 0;
+}
+
+static uint8_t *inline_data(struct inode *in) {
+    // Contenido de un archivo con INODE_MODE_INLINE, en el lugar de direct[] e indirect
+    return (uint8_t *)in + offsetof(struct inode, direct);
+}
+
+static int inode_promote_inline(struct vfs_device *dev, struct inode *in) {
+    // Pasa a bloques un archivo con los datos en el nodo-I: el contenido se escribe en su primer bloque
+    // Es responsabilidad del llamador escribir el nodo-I. Retorna 0 o -1
+    uint8_t buffer[BLOCK_SIZE] = {0};
+    memcpy(buffer, inline_data(in), in->size);
+    memset(inline_data(in), 0, INODE_INLINE_SIZE);
+    in->mode &= ~INODE_MODE_INLINE;
+
+    if (in->size == 0)
+        return 0;
+
+    if (inode_allocate_blocks(dev, in, 1) != 0)
+        return -1;
+
+    struct block_io io = {.block = (uint32_t)dev_get_block_number_at(dev, in, 0), .buffer = buffer};
+    if (dev_write_blocks(dev, &io, 1) != 0) {
+        fprintf(stderr, "Error al escribir el bloque %u\n", io.block);
+        return -1;
+    }
+    return 0;
+}
+
+int dev_inode_write_data(struct vfs_device *dev, uint32_t inode_number, void *data_buf, size_t len, size_t offset) {
     // Escribe datos en un archivo, desde un offset dado.
     // Asegura que se asignen bloques si es necesario.
     // Debe retornar len si todo anda bien
@@ -17,98 +123,184 @@ int inode_write_data(const char *image_path, uint32_t inode_number, void *data_b
     DEBUG_PRINT("inode_write_data inode_number %d, len %zu, offset %zu.\n", inode_number, len, offset);
 
     struct inode in;
-    if (read_inode(image_path, inode_number, &in) != 0) {
+    if (dev_read_inode(dev, inode_number, &in) != 0) {
         fprintf(stderr, "Error al leer el inodo %d\n", inode_number);
         return -1;
     }
 
     // Verificar que offset no supere el tamaño máximo posible
-    size_t max_file_size = (NUM_DIRECT_PTRS + NUM_INDIRECT_PTRS) * BLOCK_SIZE;
+    size_t max_file_size = (size_t)inode_max_blocks(&in) * BLOCK_SIZE;
     if (offset + len > max_file_size) {
         fprintf(stderr, "Error: Escritura supera el tamaño máximo permitido del archivo\n");
         return -1;
     }
 
-    // Leer el superbloque para validar si hay bloques disponibles
-    struct superblock sb_struct, *sb = &sb_struct;
+    // Un archivo chico con los datos en el nodo-I se escribe sin tocar bloques; si la escritura
+    // lo hace superar INODE_INLINE_SIZE, primero pasa a bloques
+    if (in.mode & INODE_MODE_INLINE) {
+        if (offset + len <= INODE_INLINE_SIZE) {
+            memcpy(inline_data(&in) + offset, data_buf, len);
+            if (offset + len > in.size)
+                in.size = offset + len;
+            in.mtime = in.atime = (uint32_t)time(NULL);
+
+            if (dev_write_inode(dev, inode_number, &in) != 0) {
+                fprintf(stderr, "Error al escribir el inodo %d\n", inode_number);
+                return -1;
+            }
+            return len;
+        }
 
-    if (read_superblock(image_path, sb) != 0) {
-        fprintf(stderr, "Error al leer superblock\n");
-        return -1;
+        DEBUG_PRINT("Pasando a bloques el inodo %u, de %u bytes.\n", inode_number, in.size);
+        if (inode_promote_inline(dev, &in) != 0)
+            return -1;
     }
 
     // Calcular cuántos bloques necesita el archivo para abarcar hasta offset + len
     size_t final_size = offset + len;
     size_t required_blocks = (final_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    size_t start_block = offset / BLOCK_SIZE;
 
     DEBUG_PRINT("final_size %zu, required_blocks %zu in.blocks %u.\n", final_size, required_blocks, in.blocks);
 
-    if (required_blocks > in.blocks) {
-        size_t to_allocate = required_blocks - in.blocks;
-        DEBUG_PRINT("final_size %zu, required_blocks %zu to_allocate %zu.\n", final_size, required_blocks, to_allocate);
+    // Bloques con contenido válido antes de esta escritura; los que siguen (recién asignados)
+    // pueden tener contenido viejo y no se leen
+    size_t old_size = in.size;
+    size_t valid_blocks = (old_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
 
-        // Validar si hay suficientes bloques libres
-        if (to_allocate > sb->free_blocks) {
-            fprintf(stderr, "Error: No hay bloques libres suficientes (%zu requeridos)\n", to_allocate);
-            return -1;
-        }
+    // Si la escritura empieza después del final del archivo, los bloques intermedios quedan como
+    // huecos: no se asignan, y se leen como ceros
+    if (in.blocks < start_block)
+        in.blocks = (uint16_t)start_block;
+    if (inode_allocate_blocks(dev, &in, required_blocks) != 0)
+        return -1;
 
-        // Asignar los bloques necesarios
-        for (size_t i = 0; i < to_allocate; i++) {
-            int new_block = bitmap_set_first_free(image_path);
-            DEBUG_PRINT("bloque adicional es %d\n", new_block);
+    // Empezar a escribir los datos
+    // Se procesa por ventanas de hasta VFS_MAX_IO_BLOCKS bloques, escritas con dev_write_blocks:
+    //  - los bloques que la escritura cubre completos se escriben directo desde data_buf, sin leerlos
+    //  - solo el primero y el último, si se escriben en forma parcial, pasan por partial_buf: se leen
+    //    si tienen contenido válido y, si no (recién asignados, que pueden tener contenido viejo con
+    //    VFS_ZERO lazy), se toman como ceros sin leerlos
+    // Lo que está más allá del tamaño anterior del archivo se considera siempre en cero: si offset deja
+    // un espacio después del final anterior, los bloques ya asignados de ese espacio se escriben con
+    // ceros. Los huecos que toca la escritura reciben bloques nuevos; los de ese espacio no.
+    static const uint8_t zero_block[BLOCK_SIZE];
+    uint8_t partial_buf[2][BLOCK_SIZE];
+    uint8_t *src = (uint8_t *)data_buf;
 
-            if (new_block == -1) {
-                fprintf(stderr, "Error al asignar bloque adicional\n");
+    size_t first_block = (start_block < valid_blocks) ? start_block : valid_blocks;
+    size_t end_block = (offset + len + BLOCK_SIZE - 1) / BLOCK_SIZE; // primer bloque que no se toca
+
+    DEBUG_PRINT("first_block: %zu start_block: %zu end_block: %zu.\n", first_block, start_block, end_block);
+
+    struct block_io ios[VFS_MAX_IO_BLOCKS];
+    struct block_io write_ios[VFS_MAX_IO_BLOCKS];
+    struct block_io read_ios[2];
+    uint8_t hole[VFS_MAX_IO_BLOCKS]; // 1 si el bloque era un hueco: no tiene contenido válido
+    struct bmap_cursor cur;
+    bmap_cursor_init(&cur, &in, first_block);
+
+    for (size_t i = first_block; i < end_block;) {
+        size_t n = 0;
+        while (n < VFS_MAX_IO_BLOCKS && i + n < end_block) {
+            size_t remaining = end_block - i - n;
+            uint32_t max_len = (uint32_t)(remaining < VFS_MAX_IO_BLOCKS - n ? remaining : VFS_MAX_IO_BLOCKS - n);
+            uint32_t start, count;
+            if (dev_bmap_next(dev, &cur, max_len, &start, &count) != 1) {
+                fprintf(stderr, "Error inesperado obteniendo el bloque número %zu del archivo\n", i + n);
                 return -1;
             }
-
-            if (inode_append_block(image_path, &in, new_block) != 0) {
-                return -1;
+            for (uint32_t k = 0; k < count; k++, n++) {
+                ios[n].block = start != 0 ? start + k : 0;
+                hole[n] = (start == 0);
             }
         }
-    }
 
-    // Empezar a escribir los datos
-    uint8_t block_buf[BLOCK_SIZE];
-    uint8_t *src = (uint8_t *)data_buf;
-    size_t remaining = len;
-
-    size_t start_block = offset / BLOCK_SIZE;
-    size_t start_offset = offset % BLOCK_SIZE;
-
-    DEBUG_PRINT("start_block: %zd start_offset: %zd.\n", start_block, start_offset);
+        // Asignar bloques a los huecos que toca la escritura, en corridas contiguas
+        int remapped = 0;
+        for (size_t j = 0; j < n;) {
+            if (ios[j].block != 0 || i + j < start_block) {
+                j++;
+                continue;
+            }
 
-    for (size_t i = start_block; remaining > 0; i++) {
-        int block_num = get_block_number_at(image_path, &in, i);
-        if (block_num <= 0) {
-            fprintf(stderr, "Error inesperado obteniendo el bloque número %zu del archivo\n", i);
-            return -1;
+            size_t hole_end = j;
+            while (hole_end < n && ios[hole_end].block == 0)
+                hole_end++;
+
+            uint32_t goal = (j > 0 && ios[j - 1].block != 0) ? ios[j - 1].block + 1 : 0;
+            while (j < hole_end) {
+                uint32_t start, count;
+                if (dev_bitmap_alloc_extent(dev, goal, (uint32_t)(hole_end - j), 1, &start, &count) != 0 ||
+                    dev_inode_map_extent(dev, &in, (uint32_t)(i + j), start, count) != 0) {
+                    fprintf(stderr, "Error al asignar bloques para el hueco en el bloque %zu del archivo\n", i + j);
+                    return -1;
+                }
+                DEBUG_PRINT("Hueco en bloque %zu: bloques %u a %u\n", i + j, start, start + count - 1);
+                for (uint32_t k = 0; k < count; k++, j++)
+                    ios[j].block = start + k;
+                goal = start + count;
+            }
+            remapped = 1;
+        }
+        if (remapped)
+            bmap_cursor_init(&cur, &in, i + n); // el cursor puede tener cargado el mapa anterior
+
+        // Ubicar el contenido de cada bloque; los parciales con contenido válido se leen juntos
+        size_t nwrite = 0, nread = 0;
+        size_t partial_index[2];
+        int partials = 0;
+        for (size_t j = 0; j < n; j++) {
+            if (ios[j].block == 0)
+                continue; // hueco anterior a offset, queda sin asignar
+
+            // Parte del bloque que cubre la escritura: [from, to) en bytes del archivo
+            size_t block_start = (i + j) * BLOCK_SIZE;
+            size_t from = (block_start > offset) ? block_start : offset;
+            size_t to = (block_start + BLOCK_SIZE < offset + len) ? block_start + BLOCK_SIZE : offset + len;
+
+            if (to <= from) {
+                ios[j].buffer = (void *)zero_block; // bloque del espacio anterior a offset
+            } else if (to - from == BLOCK_SIZE) {
+                ios[j].buffer = src + (from - offset);
+            } else {
+                ios[j].buffer = partial_buf[partials];
+                partial_index[partials++] = j;
+                if (i + j < valid_blocks && !hole[j])
+                    read_ios[nread++] = ios[j];
+                else
+                    memset(ios[j].buffer, 0, BLOCK_SIZE);
+            }
+            write_ios[nwrite++] = ios[j];
         }
 
-        // Leer el bloque actual del archivo
-        if (read_block(image_path, block_num, block_buf) != 0) {
-            fprintf(stderr, "Error inesperado leyendo bloque %d\n", block_num);
+        if (nread > 0 && dev_read_blocks(dev, read_ios, nread) != 0) {
+            fprintf(stderr, "Error inesperado leyendo bloques %u a %u\n", read_ios[0].block,
+                    read_ios[nread - 1].block);
             return -1;
         }
 
-        // Calcular cuánto escribir en este bloque
-        size_t write_offset = (i == start_block) ? start_offset : 0;
-        size_t space = BLOCK_SIZE - write_offset;
-        size_t to_write = (remaining < space) ? remaining : space;
+        // Copiar los datos nuevos en los bloques parciales
+        for (int p = 0; p < partials; p++) {
+            size_t j = partial_index[p];
+            size_t block_start = (i + j) * BLOCK_SIZE;
+            size_t from = (block_start > offset) ? block_start : offset;
+            size_t to = (block_start + BLOCK_SIZE < offset + len) ? block_start + BLOCK_SIZE : offset + len;
 
-        memcpy(block_buf + write_offset, src, to_write);
+            // Lo que sigue al final anterior del archivo, en su último bloque, se toma como ceros
+            if (i + j + 1 == valid_blocks && old_size % BLOCK_SIZE != 0)
+                memset(partial_buf[p] + old_size % BLOCK_SIZE, 0, BLOCK_SIZE - old_size % BLOCK_SIZE);
 
-        DEBUG_PRINT("Escribiendo bloque %d, Write offset %zu, space %zu, towrite %zu.\n", block_num, write_offset,
-                    space, to_write);
+            DEBUG_PRINT("Escribiendo parcial bloque %u, desde %zu hasta %zu.\n", ios[j].block, from, to);
+            memcpy(partial_buf[p] + (from - block_start), src + (from - offset), to - from);
+        }
 
-        if (write_block(image_path, block_num, block_buf) != 0) {
-            fprintf(stderr, "Error escribiendo bloque %d\n", block_num);
+        if (nwrite > 0 && dev_write_blocks(dev, write_ios, nwrite) != 0) {
+            fprintf(stderr, "Error escribiendo bloques %u a %u\n", write_ios[0].block, write_ios[nwrite - 1].block);
             return -1;
         }
 
-        src += to_write;
-        remaining -= to_write;
+        i += n;
     }
 
     // Actualizar tamaño si se escribió más allá del tamaño anterior
@@ -124,7 +316,7 @@ int inode_write_data(const char *image_path, uint32_t inode_number, void *data_b
     DEBUG_PRINT("Actualizando atime y mtime del inodo %u a %u.\n", inode_number, in.atime);
 
     // Escribir el inodo actualizado al final
-    if (write_inode(image_path, inode_number, &in) != 0) {
+    if (dev_write_inode(dev, inode_number, &in) != 0) {
         fprintf(stderr, "Error al escribir el inodo %d\n", inode_number);
         return -1;
     }
@@ -132,13 +324,132 @@ int inode_write_data(const char *image_path, uint32_t inode_number, void *data_b
     return len;
 }
 
-int inode_read_data(const char *image_path, uint32_t inode_number, void *data_buf, size_t len, size_t offset) {
+static int inode_update_atime(struct vfs_device *dev, uint32_t inode_number, struct inode *in) {
+    // Actualiza el atime después de una lectura, según dev->atime_mode. Retorna 0 o -1
+    // Con la imagen abierta solo para lectura no se actualiza, así se puede leer desde medios de
+    // solo lectura
+    if (dev->mode != VFS_OPEN_RDWR)
+        return 0;
+
+    if (dev->atime_mode == VFS_ATIME_DEFAULT) {
+        struct superblock sb_struct, *sb = &sb_struct;
+        if (dev_read_superblock(dev, sb) != 0)
+            return -1;
+
+        if (sb->features & VFS_FEATURE_NOATIME)
+            dev->atime_mode = VFS_ATIME_NOATIME;
+        else if (sb->features & VFS_FEATURE_RELATIME)
+            dev->atime_mode = VFS_ATIME_RELATIME;
+        else
+            dev->atime_mode = VFS_ATIME_STRICT;
+    }
+
+    time_t now = time(NULL);
+    if (dev->atime_mode == VFS_ATIME_NOATIME)
+        return 0;
+    if (dev->atime_mode == VFS_ATIME_RELATIME && in->atime > in->mtime && in->atime > in->ctime &&
+        (uint32_t)now - in->atime < VFS_RELATIME_SECONDS)
+        return 0; // el atime ya es posterior a la última modificación, y es reciente
+
+    DEBUG_PRINT("inode_read_data: atime valor anterior %u.\n", in->atime);
+    in->atime = (uint32_t)now;
+    DEBUG_PRINT("Actualizando atime del inodo %u a %u.\n", inode_number, in->atime);
+
+    if (dev_write_inode(dev, inode_number, in) != 0) {
+        fprintf(stderr, "Error al actualizar el atime del inodo %u.\n", inode_number);
+        return -1;
+    }
+    return 0;
+}
+
+static int inode_read_range(struct vfs_device *dev, const struct inode *in, struct bmap_cursor *cur, void *data_buf,
+                            size_t len, size_t offset) {
+    // Lee len bytes del archivo *in a partir de offset, que ya están dentro del tamaño del archivo
+    // cur debe haberse preparado sobre in; se reposiciona en el primer bloque leído, así un cursor
+    // que se reusa entre lecturas secuenciales no vuelve a leer el bloque indirecto o de desborde
+    // Retorna 0 o -1
+    if (in->mode & INODE_MODE_INLINE) {
+        // Los datos están en el nodo-I: no hay bloques para leer
+        memcpy(data_buf, inline_data((struct inode *)in) + offset, len);
+        return 0;
+    }
+
+    // Se procesa por ventanas de hasta VFS_MAX_IO_BLOCKS bloques, leídas con dev_read_blocks.
+    // Los bloques completos se leen directamente en data_buf; el primero y el último,
+    // si se leen en forma parcial, pasan por partial_buf
+    uint8_t partial_buf[2][BLOCK_SIZE];
+    uint8_t *dst = (uint8_t *)data_buf;
+
+    size_t start_block = offset / BLOCK_SIZE;
+    size_t end_block = (offset + len + BLOCK_SIZE - 1) / BLOCK_SIZE; // primer bloque que no se lee
+
+    struct block_io ios[VFS_MAX_IO_BLOCKS];
+    cur->index = (uint32_t)start_block;
+
+    for (size_t i = start_block; i < end_block;) {
+        size_t n = 0;
+        int partials = 0;
+
+        while (n < VFS_MAX_IO_BLOCKS && i + n < end_block) {
+            size_t remaining = end_block - i - n;
+            uint32_t max_len = (uint32_t)(remaining < VFS_MAX_IO_BLOCKS - n ? remaining : VFS_MAX_IO_BLOCKS - n);
+            uint32_t start, count;
+            if (dev_bmap_next(dev, cur, max_len, &start, &count) != 1) {
+                fprintf(stderr, "Error inesperado obteniendo el bloque número %zu del archivo\n", i + n);
+                return -1;
+            }
+
+            for (uint32_t k = 0; k < count; k++, n++) {
+                size_t block_start = (i + n) * BLOCK_SIZE;
+                ios[n].block = start != 0 ? start + k : 0;
+                if (block_start >= offset && block_start + BLOCK_SIZE <= offset + len)
+                    ios[n].buffer = dst + (block_start - offset);
+                else
+                    ios[n].buffer = partial_buf[partials++];
+            }
+        }
+
+        // Los huecos se leen como ceros, sin acceder a la imagen
+        struct block_io read_ios[VFS_MAX_IO_BLOCKS];
+        size_t nread = 0;
+        for (size_t j = 0; j < n; j++) {
+            if (ios[j].block == 0)
+                memset(ios[j].buffer, 0, BLOCK_SIZE);
+            else
+                read_ios[nread++] = ios[j];
+        }
+
+        if (nread > 0 && dev_read_blocks(dev, read_ios, nread) != 0) {
+            fprintf(stderr, "Error leyendo bloques %u a %u\n", read_ios[0].block, read_ios[nread - 1].block);
+            return -1;
+        }
+
+        // Copiar la parte útil de los bloques leídos en forma parcial
+        for (size_t j = 0; j < n; j++) {
+            if (ios[j].buffer != partial_buf[0] && ios[j].buffer != partial_buf[1])
+                continue;
+
+            size_t block_start = (i + j) * BLOCK_SIZE;
+            size_t from = (block_start > offset) ? block_start : offset;
+            size_t to = (block_start + BLOCK_SIZE < offset + len) ? block_start + BLOCK_SIZE : offset + len;
+
+            DEBUG_PRINT("Leyendo parcial bloque %u, desde %zu hasta %zu.\n", ios[j].block, from, to);
+            memcpy(dst + (from - offset), (uint8_t *)ios[j].buffer + (from - block_start), to - from);
+        }
+
+        i += n;
+    }
+
+    return 0;
+}
+
+int dev_inode_read_data(struct vfs_device *dev, uint32_t inode_number, void *data_buf, size_t len, size_t offset) {
     // Lee datos desde un archivo, a partir de un offset dado, hasta len bytes.
     // Retorna 0 si todo fue bien, -1 si hubo error.
     DEBUG_PRINT("inode_read_data inode_number %d, len %zu, offset %zu.\n", inode_number, len, offset);
 
     struct inode in;
-    if (read_inode(image_path, inode_number, &in) != 0) {
+    if (dev_read_inode(dev, inode_number, &in) != 0) {
         fprintf(stderr, "Error al leer el inodo %d\n", inode_number);
         return -1;
     }
@@ -154,48 +465,166 @@ int inode_read_data(const char *image_path, uint32_t inode_number, void *data_bu
         DEBUG_PRINT("Ajustando longitud de lectura a %zu bytes.\n", len);
     }
 
-    uint8_t block_buf[BLOCK_SIZE];
-    uint8_t *dst = (uint8_t *)data_buf;
-    size_t remaining = len;
+    struct bmap_cursor cur;
+    bmap_cursor_init(&cur, &in, 0);
+    if (inode_read_range(dev, &in, &cur, data_buf, len, offset) != 0)
+        return -1;
 
-    size_t start_block = offset / BLOCK_SIZE;
-    size_t start_offset = offset % BLOCK_SIZE;
+    if (inode_update_atime(dev, inode_number, &in) != 0)
+        return -1;
+
+    return len;
+}
 
-    for (size_t i = start_block; remaining > 0; i++) {
-        int block_num = get_block_number_at(image_path, &in, i);
-        if (block_num <= 0) {
-            fprintf(stderr, "Error inesperado obteniendo el bloque número %zu del archivo\n", i);
+/*
+    Lectura de un archivo abierto (struct vfs_file)
+    dev_file_open lee el nodo-I una sola vez; las lecturas posteriores usan esa copia y un
+    cursor que conserva el bloque indirecto o de desborde entre una lectura y la siguiente,
+    así leer un archivo por partes cuesta lo mismo que leerlo de una vez.
+    El atime se actualiza una sola vez, en dev_file_close.
+    Mientras el archivo está abierto no debe modificarse por otra vía.
+*/
+
+int dev_file_open(struct vfs_device *dev, uint32_t inode_number, struct vfs_file *f) {
+    // Abre el archivo regular inode_number para leerlo. Retorna 0 o -1
+    if (dev_read_inode(dev, inode_number, &f->in) != 0) {
+        fprintf(stderr, "Error al leer el inodo %d\n", inode_number);
+        return -1;
+    }
+
+    if ((f->in.mode & INODE_MODE_FILE) != INODE_MODE_FILE) {
+        fprintf(stderr, "Error: el nodo-I %u no es un archivo regular\n", inode_number);
+        errno = EINVAL;
+        return -1;
+    }
+
+    f->inode_number = inode_number;
+    bmap_cursor_init(&f->cur, &f->in, 0);
+    return 0;
+}
+
+static size_t file_clamp(const struct vfs_file *f, size_t len, size_t offset) {
+    // Cantidad de bytes que se pueden leer de f a partir de offset, como máximo len
+    if (offset >= f->in.size)
+        return 0;
+    return offset + len > f->in.size ? f->in.size - offset : len;
+}
+
+int dev_file_pread(struct vfs_device *dev, struct vfs_file *f, void *data_buf, size_t len, size_t offset) {
+    // Lee hasta len bytes de f a partir de offset, sin volver a leer el nodo-I
+    // Retorna la cantidad de bytes leídos (0 al final del archivo) o -1 en caso de error
+    len = file_clamp(f, len, offset);
+    if (len == 0)
+        return 0;
+
+    if (inode_read_range(dev, &f->in, &f->cur, data_buf, len, offset) != 0)
+        return -1;
+    return (int)len;
+}
+
+int dev_file_sendfile(struct vfs_device *dev, struct vfs_file *f, int out_fd, size_t len, size_t offset) {
+    // Como dev_file_pread, pero los datos van directo de la imagen a out_fd con dev_io_send,
+    // sin pasar por un buffer; los huecos se escriben como ceros
+    // Retorna la cantidad de bytes escritos, que puede ser menor que len si dev_io_send falla a mitad
+    // de camino, o -1; si dev_io_send no está disponible (errno EINVAL o ENOSYS) no se escribió nada
+    // y el llamador puede seguir con dev_file_pread
+    static const uint8_t zero_block[BLOCK_SIZE];
+
+    len = file_clamp(f, len, offset);
+    if (len == 0)
+        return 0;
+
+    if (f->in.mode & INODE_MODE_INLINE) {
+        const uint8_t *data = inline_data(&f->in) + offset;
+        return write(out_fd, data, len) == (ssize_t)len ? (int)len : -1;
+    }
+
+    // Los bloques sucios de la cache tienen que llegar a la imagen antes de copiarla
+    if (cache_flush(dev) != 0)
+        return -1;
+
+    size_t done = 0;
+    f->cur.index = (uint32_t)(offset / BLOCK_SIZE);
+    while (done < len) {
+        size_t pos = offset + done;
+        size_t skip = pos % BLOCK_SIZE;
+        uint32_t blocks = (uint32_t)((skip + len - done + BLOCK_SIZE - 1) / BLOCK_SIZE);
+        uint32_t start, count;
+        if (dev_bmap_next(dev, &f->cur, blocks, &start, &count) != 1) {
+            fprintf(stderr, "Error inesperado obteniendo el bloque número %zu del archivo\n", pos / BLOCK_SIZE);
             return -1;
         }
 
-        if (read_block(image_path, block_num, block_buf) != 0) {
-            fprintf(stderr, "Error leyendo bloque %d\n", block_num);
-            return -1;
+        size_t n = (size_t)count * BLOCK_SIZE - skip;
+        if (n > len - done)
+            n = len - done;
+
+        if (start != 0) {
+            size_t sent;
+            int r = dev_io_send(dev, out_fd, start, skip, n, &sent);
+            done += sent;
+            if (r != 0)
+                return done > 0 ? (int)done : -1; // como write(2): primero la cantidad ya escrita
+        } else {
+            for (size_t k = 0; k < n;) {
+                size_t chunk = n - k < BLOCK_SIZE ? n - k : BLOCK_SIZE;
+                ssize_t w = write(out_fd, zero_block, chunk);
+                if (w <= 0)
+                    return done > 0 ? (int)done : -1;
+                k += (size_t)w;
+                done += (size_t)w;
+            }
         }
+    }
+    return (int)len;
+}
 
-        size_t read_offset = (i == start_block) ? start_offset : 0;
-        size_t space = BLOCK_SIZE - read_offset;
-        size_t to_read = (remaining < space) ? remaining : space;
+int dev_file_readahead(struct vfs_device *dev, struct vfs_file *f, size_t len, size_t offset) {
+    // Avisa al sistema que se van a leer len bytes de f a partir de offset, para que empiece a
+    // traerlos mientras se procesa lo ya leído (ver dev_io_advise). Retorna 0 o -1
+    len = file_clamp(f, len, offset);
+    if (len == 0 || (f->in.mode & INODE_MODE_INLINE))
+        return 0;
+
+    // Se usa un cursor aparte, para no mover el de las lecturas
+    struct bmap_cursor cur;
+    bmap_cursor_init(&cur, &f->in, (uint32_t)(offset / BLOCK_SIZE));
+    uint32_t end_block = (uint32_t)((offset + len + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    while (cur.index < end_block) {
+        uint32_t start, count;
+        if (dev_bmap_next(dev, &cur, end_block - cur.index, &start, &count) != 1)
+            return -1;
+        if (start != 0 && dev_io_advise(dev, start, count) != 0)
+            return -1;
+    }
+    return 0;
+}
 
-        memcpy(dst, block_buf + read_offset, to_read);
+int dev_file_close(struct vfs_device *dev, struct vfs_file *f) {
+    // Cierra f y actualiza el atime del archivo. Retorna 0 o -1
+    return inode_update_atime(dev, f->inode_number, &f->in);
+}
 
-        DEBUG_PRINT("Leyendo bloque %d, Read offset %zu, space %zu, to_read %zu.\n", block_num, read_offset, space,
-                    to_read);
+// Versiones por image_path, se mantienen por compatibilidad
 
-        dst += to_read;
-        remaining -= to_read;
-    }
+int inode_write_data(const char *image_path, uint32_t inode_number, void *data_buf, size_t len, size_t offset) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
 
-    // Actualizar solo el atime
-    DEBUG_PRINT("inode_read_data: atime valor anterior %u.\n", in.atime);
-    time_t now = time(NULL);
-    in.atime = (uint32_t)now;
-    DEBUG_PRINT("Actualizando atime del inodo %u a %u.\n", inode_number, in.atime);
+    int ret = dev_inode_write_data(&dev, inode_number, data_buf, len, offset);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
 
-    if (write_inode(image_path, inode_number, &in) != 0) {
-        fprintf(stderr, "Error al actualizar el atime del inodo %u.\n", inode_number);
+int inode_read_data(const char *image_path, uint32_t inode_number, void *data_buf, size_t len, size_t offset) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
         return -1;
-    }
 
-    return len;
+    int ret = dev_inode_read_data(&dev, inode_number, data_buf, len, offset);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
 }
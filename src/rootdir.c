@@ -10,11 +10,14 @@
 
 #include "vfs.h"
 
-int create_root_dir(const char *image_path) {
+int dev_create_root_dir(struct vfs_device *dev) {
 
     struct superblock sb_str, *sb = &sb_str;
 
-    if (read_superblock(image_path, sb) != 0) {
+    // El directorio se crea de nuevo: lo que haya en la cache de entradas ya no vale
+    dcache_reset(dev);
+
+    if (dev_read_superblock(dev, sb) != 0) {
         return -1;
     }
 
@@ -23,7 +26,7 @@ int create_root_dir(const char *image_path) {
     }
 
     // Reservar un bloque de datos para el directorio
-    int rootdir_data_block = bitmap_set_first_free(image_path);
+    int rootdir_data_block = dev_bitmap_set_first_free(dev);
     DEBUG_PRINT("rootdir block %d.\n", rootdir_data_block);
     if (rootdir_data_block == -1) {
         fprintf(stderr, "No hay bloques disponibles para el bloque del directorio raiz.\n");
@@ -39,33 +42,57 @@ int create_root_dir(const char *image_path) {
     strncpy(entries[1].name, "..", FILENAME_MAX_LEN);
 
     // Actualizar y escribir el bloque de datos del directorio
-    if (write_block(image_path, rootdir_data_block, data_buffer) != 0) {
+    if (dev_write_block(dev, rootdir_data_block, data_buffer) != 0) {
         return -1;
     }
 
     // Crear el nodo-i en la posicion ROOTDIR_INODE (directorio raíz)
+    // Con la opción extents el directorio también usa extents, así puede crecer hasta MAX_EXTENT_FILE_BLOCKS
     struct inode in = {0};  // por defecto, todo inicializado en 0
     in.mode = INODE_MODE_DIR | 0755;
+    if (sb->features & VFS_FEATURE_EXTENTS)
+        in.mode |= INODE_MODE_EXTENTS;
     in.uid = getuid();
     in.gid = getgid();
-    in.blocks = 1;
+    if (dev_inode_append_block(dev, &in, rootdir_data_block) != 0)
+        return -1;
     in.size = BLOCK_SIZE;
-    in.direct[0] = rootdir_data_block;
+
+    // Con la opción dir_index, el directorio se crea con su índice, que ya incluye . y ..
+    if ((sb->features & VFS_FEATURE_DIR_INDEX) &&
+        (dev_dir_index_create(dev, &in) != 0 || dev_dir_index_insert(dev, &in, ".", 0) != 0 ||
+         dev_dir_index_insert(dev, &in, "..", 1) != 0))
+        return -1;
+
     time_t now = time(NULL);
     in.atime = in.mtime = in.ctime = (uint32_t)now;
 
-    if (write_inode(image_path, ROOTDIR_INODE, &in) != 0)
+    if (dev_write_inode(dev, ROOTDIR_INODE, &in) != 0)
         return -1;
 
     // Actualizar y re-escribir el superbloque
-    if (read_superblock(image_path, sb) != 0) {
+    if (dev_read_superblock(dev, sb) != 0) {
         return -1;
     }
     sb->free_inodes--;
-    if (write_superblock(image_path, sb) != 0) {
+    sb->dir_hint = 2; // después de . y ..
+    if (dev_write_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error: no se pudo escribir el superbloque\n");
         return -1;
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+// Versiones por image_path, se mantienen por compatibilidad
+
+int create_root_dir(const char *image_path) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_create_root_dir(&dev);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
@@ -23,14 +23,39 @@ void print_superblock(const struct superblock *sb) {
     printf("  Inode start block: %u\n", sb->inode_start);
     printf("  Bitmap start block: %u\n", sb->bitmap_start);
     printf("  Data start block: %u\n", sb->data_start);
+    printf("  Allocation hint: %u\n", sb->alloc_hint);
+    if (sb->features & VFS_FEATURE_INODE_BITMAP) {
+        printf("  Inode bitmap start block: %u\n", sb->ibitmap_start);
+        printf("  Inode bitmap blocks: %u\n", sb->ibitmap_blocks);
+    }
+    printf("  First free inode hint: %u\n", sb->inode_hint);
+    printf("  First free directory entry hint: %u\n", sb->dir_hint);
+    printf("  Features:");
+    if (sb->features == 0)
+        printf(" (none)");
+    if (sb->features & VFS_FEATURE_LAZY_ZERO)
+        printf(" lazy_zero");
+    if (sb->features & VFS_FEATURE_INODE_BITMAP)
+        printf(" inode_bitmap");
+    if (sb->features & VFS_FEATURE_EXTENTS)
+        printf(" extents");
+    if (sb->features & VFS_FEATURE_INLINE_DATA)
+        printf(" inline_data");
+    if (sb->features & VFS_FEATURE_RELATIME)
+        printf(" relatime");
+    if (sb->features & VFS_FEATURE_NOATIME)
+        printf(" noatime");
+    if (sb->features & VFS_FEATURE_DIR_INDEX)
+        printf(" dir_index");
+    printf("\n");
 }
 
-int read_superblock(const char *image_path, struct superblock *sb) {
+int dev_read_superblock(struct vfs_device *dev, struct superblock *sb) {
     // Lee el superbloque de la imagen y lo copia en `sb`.
     // Retorna 0 en caso de éxito, -1 en caso de error.
     uint8_t buffer[BLOCK_SIZE];
 
-    if (read_block(image_path, SB_BLOCK_NUMBER, buffer) != 0) {
+    if (dev_read_block(dev, SB_BLOCK_NUMBER, buffer) != 0) {
         fprintf(stderr, "Error al leer el superbloque: %s\n", strerror(errno));
         return -1;
     }
@@ -46,7 +71,7 @@ int read_superblock(const char *image_path, struct superblock *sb) {
     return 0;
 }
 
-int write_superblock(const char *image_path, struct superblock *sb) {
+int dev_write_superblock(struct vfs_device *dev, struct superblock *sb) {
     // Escribe el superbloque de la imagen a partir de `sb`.
     // Retorna 0 en caso de éxito, -1 en caso de error.
 
@@ -58,7 +83,7 @@ int write_superblock(const char *image_path, struct superblock *sb) {
         return -1;
     }
 
-    if (write_block(image_path, SB_BLOCK_NUMBER, buffer) != 0) {
+    if (dev_write_block(dev, SB_BLOCK_NUMBER, buffer) != 0) {
         fprintf(stderr, "Error al escribir el superbloque: %s\n", strerror(errno));
         return -1;
     }
@@ -66,7 +91,13 @@ int write_superblock(const char *image_path, struct superblock *sb) {
     return 0;
 }
 
-int init_superblock(const char *image_path, uint32_t total_blocks, uint32_t total_inodes) {
+int dev_init_superblock(struct vfs_device *dev, uint32_t total_blocks, uint32_t total_inodes, uint32_t features) {
+    // Inicializa el superbloque y los bitmaps de una imagen recién creada, con las opciones features
+    // Retorna 0 o -1 en caso de error
+
+    // la geometría de la tabla de nodos-I cambia: descartar lo que haya en la cache de nodos-I
+    icache_reset(dev);
+    dcache_reset(dev);
 
     uint8_t superblock_buffer[BLOCK_SIZE] = {0};
     // Acceder a la estructura de superbloque usando un puntero
@@ -83,31 +114,92 @@ int init_superblock(const char *image_path, uint32_t total_blocks, uint32_t tota
     sb->free_inodes = total_inodes;
     sb->inode_start = sb->superblock_blocks;
     sb->bitmap_start = sb->inode_start + sb->inode_blocks;
-    sb->data_start = sb->bitmap_start + sb->bitmap_blocks;
+    sb->features = features;
+    sb->ibitmap_start = sb->bitmap_start + sb->bitmap_blocks;
+    sb->ibitmap_blocks = 0;
+    if (features & VFS_FEATURE_INODE_BITMAP)
+        sb->ibitmap_blocks = (total_inodes + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
+    sb->data_start = sb->ibitmap_start + sb->ibitmap_blocks;
+    sb->alloc_hint = sb->data_start;
+    sb->inode_hint = ROOTDIR_INODE + 1;
+
+    // Bitmap de nodos-I: el 0 no se usa y el 1 es el directorio raíz
+    for (uint32_t i = 0; i < sb->ibitmap_blocks; i++) {
+        uint8_t ibitmap_buffer[BLOCK_SIZE] = {0};
+        if (i == 0)
+            ibitmap_buffer[0] = 0xC0; // bits 0 y ROOTDIR_INODE
+
+        if (dev_write_block(dev, sb->ibitmap_start + i, ibitmap_buffer) != 0) {
+            fprintf(stderr, "Error: no se pudo escribir el bloque de bitmap de nodos-I %u\n", sb->ibitmap_start + i);
+            return -1;
+        }
+    }
+
+    // Los bloques reservados (superbloque, nodos-I y bitmaps) se marcan ocupados directamente
+    // en memoria: cada bloque de bitmap se arma completo y se escribe una sola vez
+    sb->free_blocks = sb->total_blocks - sb->data_start;
 
-    // Inicializar bitmap_zeroes[]
-    sb->bitmap_zeroes[0] = BITS_PER_BLOCK - sb->data_start;
-    for (uint32_t i = 1; i < sb->bitmap_blocks; i++) {
-        sb->bitmap_zeroes[i] = BITS_PER_BLOCK;
+    for (uint32_t i = 0; i < sb->bitmap_blocks; i++) {
+        uint32_t first = i * BITS_PER_BLOCK; // primer bloque que describe este bloque de bitmap
+        uint32_t bits = sb->total_blocks - first < BITS_PER_BLOCK ? sb->total_blocks - first : BITS_PER_BLOCK;
+        uint32_t reserved = 0;
+        if (sb->data_start > first)
+            reserved = sb->data_start - first < bits ? sb->data_start - first : bits;
+
+        sb->bitmap_zeroes[i] = bits - reserved;
+
+        uint8_t bitmap_buffer[BLOCK_SIZE] = {0};
+        memset(bitmap_buffer, 0xFF, reserved / 8);
+        if (reserved % 8)
+            bitmap_buffer[reserved / 8] = (uint8_t)(0xFF << (8 - reserved % 8)); // bits de izquierda a derecha
+
+        if (dev_write_block(dev, sb->bitmap_start + i, bitmap_buffer) != 0) {
+            fprintf(stderr, "Error: no se pudo escribir el bloque de bitmap %u\n", sb->bitmap_start + i);
+            return -1;
+        }
     }
 
-    if (write_block(image_path, SB_BLOCK_NUMBER, superblock_buffer) != 0) {
+    // El área de nodos-I no se escribe: la imagen recién creada ya está en cero
+    if (dev_write_block(dev, SB_BLOCK_NUMBER, superblock_buffer) != 0) {
         fprintf(stderr, "Error: no se pudo escribir el superbloque\n");
         return -1;
     }
 
-    sb->free_blocks = sb->total_blocks; // cada invocación a bitmap_set_first_free lo decrementa
-    for (uint32_t i = 0; i < sb->data_start; i++) {
-        // prende el bit en el bitmap y decrementa free_blocks
+    return 0;
+}
 
-        int first_free = bitmap_set_first_free(image_path);
-        DEBUG_PRINT("first free block %u.\n", first_free);
+int read_superblock(const char *image_path, struct superblock *sb) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDONLY) != 0) {
+        fprintf(stderr, "Error al leer el superbloque: %s\n", strerror(errno));
+        return -1;
+    }
 
-        if (first_free != (int)i) {
-            fprintf(stderr, "Error inesperado asignando bloques libres\n");
-            return -1;
-        }
+    int ret = dev_read_superblock(&dev, sb);
+    vfs_close(&dev);
+    return ret;
+}
+
+int write_superblock(const char *image_path, struct superblock *sb) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0) {
+        fprintf(stderr, "Error al escribir el superbloque: %s\n", strerror(errno));
+        return -1;
     }
 
-    return 0;
+    int ret = dev_write_superblock(&dev, sb);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
+}
+
+int init_superblock(const char *image_path, uint32_t total_blocks, uint32_t total_inodes, uint32_t features) {
+    struct vfs_device dev;
+    if (vfs_open(&dev, image_path, VFS_OPEN_RDWR) != 0)
+        return -1;
+
+    int ret = dev_init_superblock(&dev, total_blocks, total_inodes, features);
+    if (vfs_close(&dev) != 0)
+        ret = -1;
+    return ret;
 }
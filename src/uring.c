@@ -0,0 +1,328 @@
+// uring.c
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "vfs.h"
+
+/*
+    Acceso asincrónico a la imagen con io_uring (solo Linux), usando directamente
+    las llamadas al sistema io_uring_setup e io_uring_enter, sin bibliotecas externas.
+
+    dev_io_submit() entrega aquí cada lote de corridas de bloques contiguos: se encolan
+    hasta queue_depth pedidos a la vez, y a medida que se completan se encolan los
+    siguientes. Si el kernel no soporta io_uring, uring_init() falla y el dispositivo
+    sigue usando preadv/pwritev.
+*/
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define VFS_HAVE_URING 1
+#endif
+#endif
+
+#ifdef VFS_HAVE_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+struct vfs_uring {
+    int ring_fd;
+    unsigned depth;             // Cantidad máxima de pedidos en vuelo
+
+    // Cola de envío (SQ)
+    void *sq_ring;
+    size_t sq_ring_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    // Cola de finalización (CQ)
+    void *cq_ring;
+    size_t cq_ring_size;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+};
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static void uring_unmap(struct vfs_uring *ring) {
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring)
+        munmap(ring->sq_ring, ring->sq_ring_size);
+}
+
+static int uring_map(struct vfs_uring *ring, const struct io_uring_params *p) {
+    // Mapea las colas de envío y finalización compartidas con el kernel
+    // Retorna 0 o -1 en caso de error; lo ya mapeado lo libera uring_unmap()
+    int fd = ring->ring_fd;
+
+    ring->sq_ring_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        // ambas colas comparten un solo mapeo
+        if (ring->cq_ring_size > ring->sq_ring_size)
+            ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    void *sq = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                    IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED)
+        return -1;
+    ring->sq_ring = sq;
+
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        void *cq = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                        IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED)
+            return -1;
+        ring->cq_ring = cq;
+    }
+
+    size_t sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        return -1;
+    ring->sqes = sqes;
+    ring->sqes_size = sqes_size;
+
+    uint8_t *sq_base = ring->sq_ring;
+    ring->sq_head = (unsigned *)(sq_base + p->sq_off.head);
+    ring->sq_tail = (unsigned *)(sq_base + p->sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq_base + p->sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq_base + p->sq_off.array);
+
+    uint8_t *cq_base = ring->cq_ring;
+    ring->cq_head = (unsigned *)(cq_base + p->cq_off.head);
+    ring->cq_tail = (unsigned *)(cq_base + p->cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq_base + p->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq_base + p->cq_off.cqes);
+    return 0;
+}
+
+int uring_init(struct vfs_device *dev, unsigned depth) {
+    // Crea el anillo de io_uring con lugar para depth pedidos en vuelo
+    // Retorna 0, o -1 si io_uring no está disponible (errno indica el motivo)
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    int fd = sys_io_uring_setup(depth, &p);
+    if (fd < 0)
+        return -1;
+
+    struct vfs_uring *ring = calloc(1, sizeof(struct vfs_uring));
+    if (!ring) {
+        close(fd);
+        return -1;
+    }
+
+    ring->ring_fd = fd;
+    ring->depth = depth < p.sq_entries ? depth : p.sq_entries;
+
+    if (uring_map(ring, &p) != 0) {
+        int saved_errno = errno;
+        uring_unmap(ring);
+        close(fd);
+        free(ring);
+        errno = saved_errno;
+        return -1;
+    }
+
+    dev->uring = ring;
+    DEBUG_PRINT("io_uring: %u entradas, profundidad %u\n", p.sq_entries, ring->depth);
+    return 0;
+}
+
+void uring_free(struct vfs_device *dev) {
+    struct vfs_uring *ring = dev->uring;
+    if (!ring)
+        return;
+
+    uring_unmap(ring);
+    close(ring->ring_fd);
+    free(ring);
+    dev->uring = NULL;
+}
+
+static void uring_queue_run(struct vfs_uring *ring, int fd, int write, const struct io_run *run, size_t index) {
+    // Agrega a la cola de envío el pedido de una corrida; user_data identifica la corrida
+    unsigned tail = *ring->sq_tail;
+    unsigned idx = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)run->iov;
+    sqe->len = run->iovcnt;
+    sqe->off = (uint64_t)run->block * BLOCK_SIZE;
+    sqe->user_data = index;
+
+    ring->sq_array[idx] = idx;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static unsigned uring_reap(struct vfs_device *dev, int write, const struct io_run *runs, int *ret) {
+    // Procesa los pedidos completados que haya en la cola de finalización
+    // Una corrida que se completa en forma parcial se termina con preadv/pwritev; si alguna
+    // falla deja *ret en -1. Retorna la cantidad de pedidos procesados
+    struct vfs_uring *ring = dev->uring;
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    unsigned reaped = 0;
+
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        const struct io_run *run = &runs[cqe->user_data];
+        ssize_t expected = (ssize_t)run->iovcnt * BLOCK_SIZE;
+
+        if (cqe->res < 0) {
+            errno = -cqe->res;
+            *ret = -1;
+        } else if (cqe->res != expected) {
+            // lectura o escritura parcial: se repite la corrida completa en forma sincrónica
+            DEBUG_PRINT("io_uring: corrida del bloque %u parcial (%d de %zd bytes)\n", run->block, cqe->res,
+                        expected);
+            int r = write ? dev_io_writev(dev, run->block, run->iov, run->iovcnt)
+                          : dev_io_readv(dev, run->block, run->iov, run->iovcnt);
+            if (r != 0)
+                *ret = -1;
+        } else if (write) {
+            dev->stats.bytes_written += expected;
+        } else {
+            dev->stats.bytes_read += expected;
+        }
+
+        head++;
+        reaped++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return reaped;
+}
+
+static int uring_drain(struct vfs_device *dev, int write, const struct io_run *runs, unsigned inflight, int *ret) {
+    // Espera que el kernel complete los inflight pedidos ya entregados, así ninguno queda
+    // apuntando a los iovec del llamador. Retorna 0, o -1 si io_uring_enter falla
+    struct vfs_uring *ring = dev->uring;
+    while (inflight > 0) {
+        if (sys_io_uring_enter(ring->ring_fd, 0, inflight, IORING_ENTER_GETEVENTS) < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        dev->stats.uring_enters++;
+        dev->stats.uring_inflight_sum += inflight;
+        inflight -= uring_reap(dev, write, runs, ret);
+    }
+    return 0;
+}
+
+int uring_submit_runs(struct vfs_device *dev, int write, const struct io_run *runs, size_t count) {
+    // Ejecuta las corridas manteniendo hasta ring->depth pedidos en vuelo
+    // Una corrida que se completa en forma parcial se termina con preadv/pwritev
+    // Nunca retorna con pedidos encolados o en vuelo: apuntan a los iovec de runs
+    // Retorna 0 o -1 si alguna corrida falla
+    struct vfs_uring *ring = dev->uring;
+    size_t next = 0;      // próxima corrida a encolar
+    size_t done = 0;      // corridas completadas
+    unsigned inflight = 0;
+    unsigned pending = 0; // encoladas pero todavía no entregadas al kernel
+    int ret = 0;
+
+    while (done < count) {
+        while (next < count && inflight < ring->depth) {
+            uring_queue_run(ring, dev->fd, write, &runs[next], next);
+            next++;
+            inflight++;
+            pending++;
+        }
+
+        int submitted = sys_io_uring_enter(ring->ring_fd, pending, 1, IORING_ENTER_GETEVENTS);
+        if (submitted < 0) {
+            if (errno == EINTR)
+                continue;
+
+            // Se retiran de la cola de envío los pedidos que el kernel no tomó (los últimos
+            // encolados) y se espera a los que ya están en vuelo
+            int saved_errno = errno;
+            unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+            unsigned untaken = *ring->sq_tail - head;
+            __atomic_store_n(ring->sq_tail, head, __ATOMIC_RELEASE);
+            inflight -= untaken;
+            if (uring_drain(dev, write, runs, inflight, &ret) == 0) {
+                errno = saved_errno;
+                return -1;
+            }
+
+            // No se sabe qué pedidos siguen en vuelo: se cierra el anillo y se repiten todas las
+            // corridas con preadv/pwritev, que escriben o leen lo mismo aunque ya se hayan completado
+            fprintf(stderr, "Advertencia: io_uring falló (%s), se usa pread\n", strerror(errno));
+            uring_free(dev);
+            ret = 0;
+            for (size_t i = 0; i < count && ret == 0; i++)
+                ret = write ? dev_io_writev(dev, runs[i].block, runs[i].iov, runs[i].iovcnt)
+                            : dev_io_readv(dev, runs[i].block, runs[i].iov, runs[i].iovcnt);
+            return ret;
+        }
+        pending -= (unsigned)submitted;
+
+        if (inflight > dev->stats.uring_max_inflight)
+            dev->stats.uring_max_inflight = inflight;
+        dev->stats.uring_inflight_sum += inflight;
+        dev->stats.uring_enters++;
+
+        unsigned reaped = uring_reap(dev, write, runs, &ret);
+        inflight -= reaped;
+        done += reaped;
+    }
+
+    return ret;
+}
+
+#else // !VFS_HAVE_URING
+
+int uring_init(struct vfs_device *dev, unsigned depth) {
+    (void)dev;
+    (void)depth;
+    errno = ENOSYS;
+    return -1;
+}
+
+void uring_free(struct vfs_device *dev) {
+    (void)dev;
+}
+
+int uring_submit_runs(struct vfs_device *dev, int write, const struct io_run *runs, size_t count) {
+    (void)dev;
+    (void)write;
+    (void)runs;
+    (void)count;
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif // VFS_HAVE_URING
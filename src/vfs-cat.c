@@ -4,9 +4,48 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "vfs.h"
 
+// Files are copied to stdout in chunks of this size, so memory use does not depend on file size
+#define CAT_CHUNK ((size_t)VFS_MAX_IO_BLOCKS * BLOCK_SIZE)
+
+static uint8_t chunk_buffer[CAT_CHUNK];
+static int use_sendfile = 1; // cleared the first time the image cannot be sent straight to stdout
+
+static int cat_file(struct vfs_device *dev, struct vfs_file *f) {
+    // Copy the open file f to stdout, one chunk at a time
+    // While a chunk is written, the kernel is already reading the next one (dev_file_readahead)
+    // Returns 0, -1 on read errors or -2 if stdout cannot be written
+    size_t size = f->in.size;
+    for (size_t offset = 0; offset < size;) {
+        dev_file_readahead(dev, f, CAT_CHUNK, offset + CAT_CHUNK); // only a hint, errors are ignored
+
+        if (use_sendfile) {
+            if (fflush(stdout) != 0)
+                return -2;
+            int sent = dev_file_sendfile(dev, f, STDOUT_FILENO, CAT_CHUNK, offset);
+            if (sent > 0) {
+                offset += (size_t)sent;
+                continue;
+            }
+            if (sent < 0 && errno != EINVAL && errno != ENOSYS)
+                return -2;
+            use_sendfile = 0; // e.g. stdout opened with O_APPEND: fall back to read + write
+        }
+
+        int bytes_read = dev_file_pread(dev, f, chunk_buffer, CAT_CHUNK, offset);
+        if (bytes_read <= 0)
+            return -1;
+
+        if (fwrite(chunk_buffer, 1, (size_t)bytes_read, stdout) != (size_t)bytes_read)
+            return -2;
+        offset += (size_t)bytes_read;
+    }
+    return 0;
+}
+
 // Display file contents
 int main(int argc, char *argv[]) {
     if (argc < 3) {
@@ -17,10 +56,21 @@ int main(int argc, char *argv[]) {
     const char *image_path = argv[1];
     int errors = 0;
 
+    // Open image; if it cannot be written (e.g. read-only media), read it without updating atime
+    struct vfs_device dev_struct, *dev = &dev_struct;
+    int opened = vfs_open(dev, image_path, VFS_OPEN_RDWR);
+    if (opened != 0 && (errno == EACCES || errno == EROFS || errno == EPERM))
+        opened = vfs_open(dev, image_path, VFS_OPEN_RDONLY);
+    if (opened != 0) {
+        fprintf(stderr, "Error opening image %s: %s\n", image_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
     // Verify image
     struct superblock sb_struct, *sb = &sb_struct;
-    if (read_superblock(image_path, sb) != 0) {
+    if (dev_read_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error reading superblock\n");
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
@@ -29,7 +79,7 @@ int main(int argc, char *argv[]) {
         const char *filename = argv[i];
 
         // Look up file in directory
-        int inode_num = dir_lookup(image_path, filename);
+        int inode_num = dev_dir_lookup(dev, filename);
         if (inode_num == 0) {
             fprintf(stderr, "File '%s' not found\n", filename);
             errors++;
@@ -41,48 +91,44 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
-        // Read inode
-        struct inode file_inode;
-        if (read_inode(image_path, inode_num, &file_inode) != 0) {
-            fprintf(stderr, "Error reading inode for '%s'\n", filename);
+        // Open the file and copy it to stdout
+        struct vfs_file file;
+        if (dev_file_open(dev, inode_num, &file) != 0) {
+            fprintf(stderr, "Error opening file '%s'\n", filename);
             errors++;
             continue;
         }
 
-        // Check if it's a regular file
-        if ((file_inode.mode & INODE_MODE_FILE) != INODE_MODE_FILE) {
-            fprintf(stderr, "'%s' is not a regular file\n", filename);
+        int ret = cat_file(dev, &file);
+        if (ret == -2) {
+            fprintf(stderr, "Error writing to stdout\n");
+            vfs_close(dev);
+            return EXIT_FAILURE;
+        }
+        if (ret != 0) {
+            fprintf(stderr, "Error reading data from file '%s'\n", filename);
             errors++;
-            continue;
         }
 
-        // Read and display file contents
-        if (file_inode.size > 0) {
-            uint8_t *buffer = malloc(file_inode.size);
-            if (!buffer) {
-                fprintf(stderr, "Error allocating memory for file '%s'\n", filename);
-                errors++;
-                continue;
-            }
-
-            ssize_t bytes_read = inode_read_data(image_path, inode_num, buffer, file_inode.size, 0);
-            if (bytes_read < 0) {
-                fprintf(stderr, "Error reading data from file '%s'\n", filename);
-                free(buffer);
-                errors++;
-                continue;
-            }
+        if (dev_file_close(dev, &file) != 0) {
+            fprintf(stderr, "Error updating access time of '%s'\n", filename);
+            errors++;
+        }
+    }
 
-            // Write to stdout
-            if (fwrite(buffer, 1, bytes_read, stdout) != (size_t)bytes_read) {
-                fprintf(stderr, "Error writing to stdout\n");
-                free(buffer);
-                return EXIT_FAILURE;
-            }
+    if (fflush(stdout) != 0) {
+        fprintf(stderr, "Error writing to stdout\n");
+        vfs_close(dev);
+        return EXIT_FAILURE;
+    }
 
-            free(buffer);
-        }
+    // Write pending blocks to the image
+    if (vfs_flush(dev) != 0) {
+        fprintf(stderr, "Error writing pending blocks to %s\n", image_path);
+        vfs_close(dev);
+        return EXIT_FAILURE;
     }
 
+    vfs_close(dev);
     return errors > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -11,6 +11,16 @@
 
 #include "vfs.h"
 
+static size_t block_len(ssize_t nread, size_t pos) {
+    // Bytes del bloque que empieza en pos, dentro de los nread leídos
+    return (size_t)nread - pos < BLOCK_SIZE ? (size_t)nread - pos : BLOCK_SIZE;
+}
+
+static int is_zero_block(const uint8_t *data, size_t len) {
+    // 1 si los len bytes de data están en cero
+    return data[0] == 0 && memcmp(data, data + 1, len - 1) == 0;
+}
+
 // Copia un archivo del sistema anfitrión al filesystem virtual.
 int main(int argc, char *argv[]) {
     if (argc != 4) {
@@ -22,23 +32,33 @@ int main(int argc, char *argv[]) {
     const char *host_file = argv[2];
     const char *dest_name = argv[3];
 
+    // Abrir imagen
+    struct vfs_device dev_struct, *dev = &dev_struct;
+    if (vfs_open(dev, image_path, VFS_OPEN_RDWR) != 0) {
+        fprintf(stderr, "Error al abrir la imagen %s: %s\n", image_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
     // Verificar imagen
     struct superblock sb_struct, *sb = &sb_struct;
     
-    if (read_superblock(image_path, sb) != 0) {
+    if (dev_read_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error al leer superblock\n");
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
     // Verificar nombre válido
     if (!name_is_valid(dest_name)) {
         fprintf(stderr, "Nombre inválido: %s\n", dest_name);
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
     // Verificar si ya existe en el directorio
-    if (dir_lookup(image_path, dest_name) != 0) {
+    if (dev_dir_lookup(dev, dest_name) != 0) {
         fprintf(stderr, "El nombre '%s' ya existe en el directorio\n", dest_name);
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
@@ -46,6 +66,7 @@ int main(int argc, char *argv[]) {
     int fd = open(host_file, O_RDONLY);
     if (fd < 0) {
         fprintf(stderr, "Error (%s) al abrir archivo %s\n", strerror(errno), host_file);
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
@@ -54,40 +75,74 @@ int main(int argc, char *argv[]) {
     if (fstat(fd, &st) != 0) {
         fprintf(stderr, "Error al obtener tamaño de archivo %s.\n", host_file);
         close(fd);
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
     uint16_t perms = st.st_mode & 0777;
     
     // Crear nodo-I vacío
-    int new_inode = create_empty_file_in_free_inode(image_path, perms);
+    int new_inode = dev_create_empty_file_in_free_inode(dev, perms);
     if (new_inode < 0) {
         fprintf(stderr, "Error al crear archivo destino en VFS\n");
         close(fd);
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
     
     // Agregar entrada al directorio raíz
-    if (add_dir_entry(image_path, dest_name, new_inode) != 0) {
+    if (dev_add_dir_entry(dev, dest_name, new_inode) != 0) {
         fprintf(stderr, "Error al agregar entrada de directorio para %s\n", dest_name);
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
     
-    // Leer y escribir por bloques
-    uint8_t buffer[BLOCK_SIZE];
+    // Leer y escribir de a varios bloques, para que cada escritura se haga en un solo lote
+    // Los bloques en cero no se escriben: quedan como huecos del archivo, sin ocupar lugar en la imagen.
+    // Los bloques escritos se asignan a continuación del último, así el archivo queda contiguo
+    static uint8_t buffer[VFS_MAX_IO_BLOCKS * BLOCK_SIZE];
     ssize_t nread;
+    size_t offset = 0, written = 0; // written: final de lo último escrito
 
-    for (size_t offset = 0; (nread = read(fd, buffer, BLOCK_SIZE)) != 0; offset += nread) {
+    for (; (nread = read(fd, buffer, sizeof(buffer))) != 0; offset += nread) {
 
         if (nread < 0) {
             fprintf(stderr, "Error al leer archivo origen %s\n", host_file);
             close(fd);
+            vfs_close(dev);
             return EXIT_FAILURE;
         }
 
-        if (inode_write_data(image_path, new_inode, buffer, nread, offset) != nread) {
-            fprintf(stderr, "Error al escribir datos en VFS, nodo-I nro %d, nread %zu, offset %zd.\n", new_inode, nread, offset);
+        // Escribir cada corrida de bloques que no están en cero
+        for (size_t pos = 0; pos < (size_t)nread;) {
+            size_t run = pos;
+            while (run < (size_t)nread && !is_zero_block(buffer + run, block_len(nread, run)))
+                run += block_len(nread, run);
+
+            if (run > pos) {
+                if (dev_inode_write_data(dev, new_inode, buffer + pos, run - pos, offset + pos) != (int)(run - pos)) {
+                    fprintf(stderr, "Error al escribir datos en VFS, nodo-I nro %d, len %zu, offset %zu.\n",
+                            new_inode, run - pos, offset + pos);
+                    close(fd);
+                    vfs_close(dev);
+                    return EXIT_FAILURE;
+                }
+                written = offset + run;
+            }
+
+            pos = run;
+            while (pos < (size_t)nread && is_zero_block(buffer + pos, block_len(nread, pos)))
+                pos += block_len(nread, pos);
+        }
+    }
+
+    // Si el archivo termina en ceros, se escribe su último byte para que quede con el tamaño del origen
+    if (offset > written) {
+        uint8_t zero = 0;
+        if (dev_inode_write_data(dev, new_inode, &zero, 1, offset - 1) != 1) {
+            fprintf(stderr, "Error al escribir datos en VFS, nodo-I nro %d, offset %zu.\n", new_inode, offset - 1);
             close(fd);
+            vfs_close(dev);
             return EXIT_FAILURE;
         }
     }
@@ -95,5 +150,13 @@ int main(int argc, char *argv[]) {
     close(fd);
 
     DEBUG_PRINT("Archivo copiado exitosamente como '%s' (inode %d)\n", dest_name, new_inode);
+    // Escribir los bloques pendientes en la imagen
+    if (vfs_flush(dev) != 0) {
+        fprintf(stderr, "Error al escribir los bloques pendientes en %s\n", image_path);
+        vfs_close(dev);
+        return EXIT_FAILURE;
+    }
+
+    vfs_close(dev);
     return EXIT_SUCCESS;
 }
@@ -15,10 +15,19 @@ int main(int argc, char *argv[])
     }
 
     const char *image_path = argv[1];
+
+    // Abrir imagen
+    struct vfs_device dev_struct, *dev = &dev_struct;
+    if (vfs_open(dev, image_path, VFS_OPEN_RDONLY) != 0) {
+        fprintf(stderr, "Error al abrir la imagen %s: %s\n", image_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
     struct superblock sb_struct;
     
-    if (read_superblock(image_path, &sb_struct) != 0) {
+    if (dev_read_superblock(dev, &sb_struct) != 0) {
         fprintf(stderr, "Error al leer superblock\n");
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
@@ -29,9 +38,10 @@ int main(int argc, char *argv[])
     uint32_t to_print = sb_struct.total_blocks;
     for (uint32_t i = 0; i < sb_struct.bitmap_blocks; i++)
     {
-        if (read_block(image_path, sb_struct.bitmap_start + i, buffer) != 0)
+        if (dev_read_block(dev, sb_struct.bitmap_start + i, buffer) != 0)
         {
             fprintf(stderr, "Error al leer bloque de bitmap %u\n", i);
+            vfs_close(dev);
             return EXIT_FAILURE;
         }
 
@@ -39,5 +49,13 @@ int main(int argc, char *argv[])
         to_print -= BLOCK_SIZE;
     }
 
+    // Escribir los bloques pendientes en la imagen
+    if (vfs_flush(dev) != 0) {
+        fprintf(stderr, "Error al escribir los bloques pendientes en %s\n", image_path);
+        vfs_close(dev);
+        return EXIT_FAILURE;
+    }
+
+    vfs_close(dev);
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -16,17 +16,26 @@ int main(int argc, char *argv[]) {
 
     const char *image_path = argv[1];
 
+    // Open image
+    struct vfs_device dev_struct, *dev = &dev_struct;
+    if (vfs_open(dev, image_path, VFS_OPEN_RDONLY) != 0) {
+        fprintf(stderr, "Error opening image %s: %s\n", image_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
     // Read superblock
     struct superblock sb_struct, *sb = &sb_struct;
-    if (read_superblock(image_path, sb) != 0) {
+    if (dev_read_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error reading superblock\n");
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
     // Read root directory inode
     struct inode root_inode;
-    if (read_inode(image_path, ROOTDIR_INODE, &root_inode) != 0) {
+    if (dev_read_inode(dev, ROOTDIR_INODE, &root_inode) != 0) {
         fprintf(stderr, "Error reading root directory inode\n");
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
@@ -34,39 +43,77 @@ int main(int argc, char *argv[]) {
     printf("Inode Type Permissions Owner      Group       Blocks     Size Created             Modified            Accessed            Name\n");
     printf("===== ==== =========== ========== ========== ====== ======== =================== =================== =================== ====\n");
 
-    // Iterate through all data blocks of root directory
-    for (uint16_t i = 0; i < root_inode.blocks; i++) {
-        int block_num = get_block_number_at(image_path, &root_inode, i);
-        if (block_num <= 0) {
-            fprintf(stderr, "Error getting block %d of root directory\n", i);
-            return EXIT_FAILURE;
-        }
+    // Iterate through all data blocks of root directory, one physical run at a time
+    struct bmap_cursor cur;
+    bmap_cursor_init(&cur, &root_inode, 0);
+    uint32_t start, count;
+    int r;
+    while ((r = dev_bmap_next(dev, &cur, UINT32_MAX, &start, &count)) == 1) {
+        if (start == 0)
+            continue; // a hole has no entries; block 0 is the superblock
 
-        uint8_t data_buf[BLOCK_SIZE];
-        if (read_block(image_path, block_num, data_buf) != 0) {
-            fprintf(stderr, "Error reading block %d\n", block_num);
-            return EXIT_FAILURE;
-        }
+        for (uint32_t block_num = start; block_num < start + count; block_num++) {
+            uint8_t data_buf[BLOCK_SIZE];
+            if (dev_read_block(dev, block_num, data_buf) != 0) {
+                fprintf(stderr, "Error reading block %u\n", block_num);
+                vfs_close(dev);
+                return EXIT_FAILURE;
+            }
 
-        struct dir_entry *entries = (struct dir_entry *)data_buf;
+            struct dir_entry *entries = (struct dir_entry *)data_buf;
 
-        // Process each directory entry
-        for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
-            if (entries[j].inode == 0) {
-                continue; // Empty entry
+            // Fetch the inode-table blocks for this directory block in one batch
+            uint32_t inode_numbers[DIR_ENTRIES_PER_BLOCK];
+            size_t n = 0;
+            for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
+                if (entries[j].inode != 0)
+                    inode_numbers[n++] = entries[j].inode;
             }
-
-            // Read inode for this entry
-            struct inode file_inode;
-            if (read_inode(image_path, entries[j].inode, &file_inode) != 0) {
-                fprintf(stderr, "Error reading inode %u\n", entries[j].inode);
-                continue;
+            if (dev_inode_prefetch(dev, inode_numbers, n) != 0) {
+                fprintf(stderr, "Error reading inodes of block %u\n", block_num);
+                vfs_close(dev);
+                return EXIT_FAILURE;
             }
 
-            // Print file information
-            print_inode(&file_inode, entries[j].inode, entries[j].name);
+            // Process each directory entry
+            for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
+                if (entries[j].inode == 0) {
+                    continue; // Empty entry
+                }
+
+                // Read inode for this entry
+                struct inode file_inode;
+                if (dev_read_inode(dev, entries[j].inode, &file_inode) != 0) {
+                    fprintf(stderr, "Error reading inode %u\n", entries[j].inode);
+                    continue;
+                }
+
+                // The Blocks column shows allocated blocks: file_inode.blocks also counts holes
+                uint32_t blocks;
+                if (dev_inode_allocated_blocks(dev, &file_inode, &blocks) != 0) {
+                    fprintf(stderr, "Error reading the blocks of inode %u\n", entries[j].inode);
+                    continue;
+                }
+
+                // Print file information
+                print_inode(&file_inode, blocks, entries[j].inode, entries[j].name);
+            }
         }
     }
 
+    if (r < 0) {
+        fprintf(stderr, "Error getting block %u of root directory\n", cur.index);
+        vfs_close(dev);
+        return EXIT_FAILURE;
+    }
+
+    // Write pending blocks to the image
+    if (vfs_flush(dev) != 0) {
+        fprintf(stderr, "Error writing pending blocks to %s\n", image_path);
+        vfs_close(dev);
+        return EXIT_FAILURE;
+    }
+
+    vfs_close(dev);
     return EXIT_SUCCESS;
 }
\ No newline at end of file
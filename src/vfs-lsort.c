@@ -4,121 +4,335 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "vfs.h"
 
 // Structure to hold file information for sorting
 struct file_info {
     uint32_t inode_num;
-    char name[FILENAME_MAX_LEN];
+    char name[FILENAME_MAX_LEN]; // zero-padded, as in the directory entry
     struct inode inode_data;
+    uint32_t blocks; // allocated data blocks; inode_data.blocks also counts holes
 };
 
-// Comparison function for qsort
-int compare_names(const void *a, const void *b) {
-    const struct file_info *file_a = (const struct file_info *)a;
-    const struct file_info *file_b = (const struct file_info *)b;
-    return strcmp(file_a->name, file_b->name);
+// Sort keys for -k
+enum sort_key { KEY_NAME, KEY_SIZE, KEY_BLOCKS, KEY_MTIME, KEY_ATIME, KEY_INODE };
+
+static const char *key_names[] = {"name", "size", "blocks", "mtime", "atime", "inode"};
+
+// Below this many entries a radix pass costs more than an insertion sort
+#define RADIX_CUTOFF 32
+
+static void name_insertion_sort(struct file_info **files, size_t n, int depth) {
+    // Insertion sort on the name bytes from depth on
+    for (size_t i = 1; i < n; i++) {
+        struct file_info *f = files[i];
+        size_t j = i;
+        while (j > 0 && memcmp(files[j - 1]->name + depth, f->name + depth, FILENAME_MAX_LEN - depth) > 0) {
+            files[j] = files[j - 1];
+            j--;
+        }
+        files[j] = f;
+    }
+}
+
+static void name_radix_sort(struct file_info **files, struct file_info **aux, size_t n, int depth) {
+    // MSD radix sort on the fixed, zero-padded names: one byte per level, 256 buckets
+    // Comparing bytes as unsigned gives the same order as strcmp
+    if (n < RADIX_CUTOFF) {
+        name_insertion_sort(files, n, depth);
+        return;
+    }
+
+    size_t start[257] = {0};
+    for (size_t i = 0; i < n; i++)
+        start[(uint8_t)files[i]->name[depth] + 1]++;
+    for (int b = 0; b < 256; b++)
+        start[b + 1] += start[b];
+
+    size_t next[256];
+    memcpy(next, start, sizeof(next));
+    for (size_t i = 0; i < n; i++)
+        aux[next[(uint8_t)files[i]->name[depth]]++] = files[i];
+    memcpy(files, aux, n * sizeof(struct file_info *));
+
+    // Bucket 0 holds the names that ended at depth: they are all equal
+    if (depth + 1 == FILENAME_MAX_LEN)
+        return;
+    for (int b = 1; b < 256; b++)
+        if (start[b + 1] - start[b] > 1)
+            name_radix_sort(files + start[b], aux, start[b + 1] - start[b], depth + 1);
+}
+
+static uint32_t sort_value(const struct file_info *f, enum sort_key key) {
+    // Numeric sort key; size, blocks and times are complemented so that larger and newer sort first, like ls
+    switch (key) {
+    case KEY_SIZE:
+        return ~f->inode_data.size;
+    case KEY_BLOCKS:
+        return ~f->blocks;
+    case KEY_MTIME:
+        return ~f->inode_data.mtime;
+    case KEY_ATIME:
+        return ~f->inode_data.atime;
+    default:
+        return f->inode_num;
+    }
+}
+
+static void key_radix_sort(struct file_info **files, struct file_info **aux, size_t n, enum sort_key key) {
+    // Stable LSD radix sort on a 32-bit key, one byte per pass: entries with equal keys keep their order
+    for (int shift = 0; shift < 32; shift += 8) {
+        size_t start[257] = {0};
+        for (size_t i = 0; i < n; i++)
+            start[((sort_value(files[i], key) >> shift) & 0xFF) + 1]++;
+        if (start[((sort_value(files[0], key) >> shift) & 0xFF) + 1] == n)
+            continue; // every entry has the same byte here
+        for (int b = 0; b < 256; b++)
+            start[b + 1] += start[b];
+
+        for (size_t i = 0; i < n; i++)
+            aux[start[(sort_value(files[i], key) >> shift) & 0xFF]++] = files[i];
+        memcpy(files, aux, n * sizeof(struct file_info *));
+    }
+}
+
+static int read_inodes_by_table_block(struct vfs_device *dev, struct file_info *files, uint32_t total_entries) {
+    // Reads the inodes of all entries visiting the inode table in order, one table block at a time:
+    // each block is read once whatever the order of the entries in the directory
+    // Returns 0 or -1
+    uint32_t *order = malloc((total_entries > 0 ? total_entries : 1) * sizeof(uint32_t));
+    uint32_t *aux = malloc((total_entries > 0 ? total_entries : 1) * sizeof(uint32_t));
+    if (!order || !aux) {
+        free(order);
+        free(aux);
+        return -1;
+    }
+
+    // Entries sorted by inode number, with a radix sort on the entry indices
+    for (uint32_t i = 0; i < total_entries; i++)
+        order[i] = i;
+    for (int shift = 0; shift < 32; shift += 8) {
+        size_t start[257] = {0};
+        for (uint32_t i = 0; i < total_entries; i++)
+            start[((files[order[i]].inode_num >> shift) & 0xFF) + 1]++;
+        for (int b = 0; b < 256; b++)
+            start[b + 1] += start[b];
+        for (uint32_t i = 0; i < total_entries; i++)
+            aux[start[(files[order[i]].inode_num >> shift) & 0xFF]++] = order[i];
+        memcpy(order, aux, total_entries * sizeof(uint32_t));
+    }
+    free(aux);
+
+    // With the inode cache, all the missing table blocks are read in one batch first
+    int ret = 0;
+    if (dev->icache) {
+        uint32_t *inode_numbers = malloc((total_entries > 0 ? total_entries : 1) * sizeof(uint32_t));
+        if (!inode_numbers) {
+            free(order);
+            return -1;
+        }
+        for (uint32_t i = 0; i < total_entries; i++)
+            inode_numbers[i] = files[order[i]].inode_num;
+        ret = dev_inode_prefetch(dev, inode_numbers, total_entries);
+        free(inode_numbers);
+    }
+
+    // Each run of entries whose inodes share a table block is copied from a single read
+    for (uint32_t i = 0; ret == 0 && i < total_entries;) {
+        uint32_t first = files[order[i]].inode_num;
+        uint32_t end = i;
+        while (end < total_entries && files[order[end]].inode_num / INODES_PER_BLOCK == first / INODES_PER_BLOCK)
+            end++;
+        uint32_t last = files[order[end - 1]].inode_num;
+
+        struct inode inodes[INODES_PER_BLOCK];
+        if (dev_read_inodes(dev, first, last - first + 1, inodes) != 0) {
+            fprintf(stderr, "Error reading inodes %u to %u\n", first, last);
+            ret = -1;
+            break;
+        }
+        for (; i < end && ret == 0; i++) {
+            struct file_info *f = &files[order[i]];
+            f->inode_data = inodes[f->inode_num - first];
+            if (dev_inode_allocated_blocks(dev, &f->inode_data, &f->blocks) != 0) {
+                fprintf(stderr, "Error reading the blocks of inode %u\n", f->inode_num);
+                ret = -1;
+            }
+        }
+    }
+
+    free(order);
+    return ret;
 }
 
-// List directory contents in ls -l style, sorted alphabetically
+// List directory contents in ls -l style, sorted by name or by the key given with -k
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s image\n", argv[0]);
+    enum sort_key key = KEY_NAME;
+    int reverse = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "k:r")) != -1) {
+        switch (opt) {
+        case 'k': {
+            size_t k;
+            for (k = 0; k < sizeof(key_names) / sizeof(key_names[0]); k++)
+                if (strcmp(optarg, key_names[k]) == 0)
+                    break;
+            if (k == sizeof(key_names) / sizeof(key_names[0])) {
+                fprintf(stderr, "Unknown sort key: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            key = (enum sort_key)k;
+            break;
+        }
+        case 'r':
+            reverse = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-r] [-k name|size|blocks|mtime|atime|inode] image\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - optind != 1) {
+        fprintf(stderr, "Usage: %s [-r] [-k name|size|blocks|mtime|atime|inode] image\n", argv[0]);
         return EXIT_FAILURE;
     }
 
-    const char *image_path = argv[1];
+    const char *image_path = argv[optind];
+
+    // Open image
+    struct vfs_device dev_struct, *dev = &dev_struct;
+    if (vfs_open(dev, image_path, VFS_OPEN_RDONLY) != 0) {
+        fprintf(stderr, "Error opening image %s: %s\n", image_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
 
     // Read superblock
     struct superblock sb_struct, *sb = &sb_struct;
-    if (read_superblock(image_path, sb) != 0) {
+    if (dev_read_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error reading superblock\n");
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
     // Read root directory inode
     struct inode root_inode;
-    if (read_inode(image_path, ROOTDIR_INODE, &root_inode) != 0) {
+    if (dev_read_inode(dev, ROOTDIR_INODE, &root_inode) != 0) {
         fprintf(stderr, "Error reading root directory inode\n");
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
-    // Count total entries first
+    // Read all entries into a growing array, walking the directory one physical run at a time
     uint32_t total_entries = 0;
-    for (uint16_t i = 0; i < root_inode.blocks; i++) {
-        int block_num = get_block_number_at(image_path, &root_inode, i);
-        if (block_num <= 0) {
-            fprintf(stderr, "Error getting block %d of root directory\n", i);
-            return EXIT_FAILURE;
-        }
-
-        uint8_t data_buf[BLOCK_SIZE];
-        if (read_block(image_path, block_num, data_buf) != 0) {
-            fprintf(stderr, "Error reading block %d\n", block_num);
-            return EXIT_FAILURE;
-        }
-
-        struct dir_entry *entries = (struct dir_entry *)data_buf;
-        for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
-            if (entries[j].inode != 0) {
-                total_entries++;
-            }
-        }
-    }
-
-    // Allocate array for all entries
-    struct file_info *files = malloc(total_entries * sizeof(struct file_info));
+    uint32_t capacity = DIR_ENTRIES_PER_BLOCK;
+    struct file_info *files = malloc(capacity * sizeof(struct file_info));
     if (!files) {
         fprintf(stderr, "Error allocating memory\n");
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
-    // Read all entries into array
-    uint32_t file_index = 0;
-    for (uint16_t i = 0; i < root_inode.blocks; i++) {
-        int block_num = get_block_number_at(image_path, &root_inode, i);
-        if (block_num <= 0) {
-            free(files);
-            return EXIT_FAILURE;
-        }
+    struct bmap_cursor cur;
+    bmap_cursor_init(&cur, &root_inode, 0);
+    uint32_t start, count;
+    int r;
+    while ((r = dev_bmap_next(dev, &cur, UINT32_MAX, &start, &count)) == 1) {
+        if (start == 0)
+            continue; // a hole has no entries; block 0 is the superblock
 
-        uint8_t data_buf[BLOCK_SIZE];
-        if (read_block(image_path, block_num, data_buf) != 0) {
-            free(files);
-            return EXIT_FAILURE;
-        }
+        for (uint32_t block_num = start; block_num < start + count; block_num++) {
+            uint8_t data_buf[BLOCK_SIZE];
+            if (dev_read_block(dev, block_num, data_buf) != 0) {
+                fprintf(stderr, "Error reading block %u\n", block_num);
+                free(files);
+                vfs_close(dev);
+                return EXIT_FAILURE;
+            }
 
-        struct dir_entry *entries = (struct dir_entry *)data_buf;
-        for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
-            if (entries[j].inode != 0) {
-                files[file_index].inode_num = entries[j].inode;
-                strncpy(files[file_index].name, entries[j].name, FILENAME_MAX_LEN);
-                
-                // Read inode data
-                if (read_inode(image_path, entries[j].inode, &files[file_index].inode_data) != 0) {
-                    fprintf(stderr, "Error reading inode %u\n", entries[j].inode);
+            if (total_entries + DIR_ENTRIES_PER_BLOCK > capacity) {
+                capacity *= 2;
+                struct file_info *grown = realloc(files, capacity * sizeof(struct file_info));
+                if (!grown) {
+                    fprintf(stderr, "Error allocating memory\n");
                     free(files);
+                    vfs_close(dev);
                     return EXIT_FAILURE;
                 }
-                
-                file_index++;
+                files = grown;
+            }
+
+            struct dir_entry *entries = (struct dir_entry *)data_buf;
+            uint32_t match, free_mask;
+            dir_block_scan(entries, NULL, &match, &free_mask);
+            for (uint32_t in_use = ~free_mask; in_use != 0; in_use &= in_use - 1) {
+                uint32_t j = (uint32_t)__builtin_ctz(in_use);
+                files[total_entries].inode_num = entries[j].inode;
+                strncpy(files[total_entries].name, entries[j].name, FILENAME_MAX_LEN); // pads with zeros
+                total_entries++;
             }
         }
     }
 
-    // Sort entries by name
-    qsort(files, total_entries, sizeof(struct file_info), compare_names);
+    if (r < 0) {
+        fprintf(stderr, "Error getting block %u of root directory\n", cur.index);
+        free(files);
+        vfs_close(dev);
+        return EXIT_FAILURE;
+    }
+
+    if (read_inodes_by_table_block(dev, files, total_entries) != 0) {
+        fprintf(stderr, "Error reading inodes\n");
+        free(files);
+        vfs_close(dev);
+        return EXIT_FAILURE;
+    }
+
+    // Sort pointers to the entries: by name, and then by the key (stable, so equal keys stay sorted by name)
+    struct file_info **sorted = malloc((total_entries > 0 ? total_entries : 1) * sizeof(struct file_info *));
+    struct file_info **aux = malloc((total_entries > 0 ? total_entries : 1) * sizeof(struct file_info *));
+    if (!sorted || !aux) {
+        fprintf(stderr, "Error allocating memory\n");
+        free(sorted);
+        free(aux);
+        free(files);
+        vfs_close(dev);
+        return EXIT_FAILURE;
+    }
+    for (uint32_t i = 0; i < total_entries; i++)
+        sorted[i] = &files[i];
+
+    name_radix_sort(sorted, aux, total_entries, 0);
+    if (key != KEY_NAME && total_entries > 0)
+        key_radix_sort(sorted, aux, total_entries, key);
+    free(aux);
 
     // Print header
+    static char out_buf[1 << 16];
+    setvbuf(stdout, out_buf, _IOFBF, sizeof(out_buf));
     printf("Inode Type Permissions Owner      Group       Blocks     Size Created             Modified            Accessed            Name\n");
     printf("===== ==== =========== ========== ========== ====== ======== =================== =================== =================== ====\n");
 
     // Print sorted entries
     for (uint32_t i = 0; i < total_entries; i++) {
-        print_inode(&files[i].inode_data, files[i].inode_num, files[i].name);
+        const struct file_info *f = sorted[reverse ? total_entries - 1 - i : i];
+        char name[FILENAME_MAX_LEN + 1] = {0};
+        memcpy(name, f->name, FILENAME_MAX_LEN);
+        print_inode(&f->inode_data, f->blocks, f->inode_num, name);
     }
 
+    free(sorted);
     free(files);
+
+    // Write pending blocks to the image
+    if (vfs_flush(dev) != 0) {
+        fprintf(stderr, "Error writing pending blocks to %s\n", image_path);
+        vfs_close(dev);
+        return EXIT_FAILURE;
+    }
+
+    vfs_close(dev);
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
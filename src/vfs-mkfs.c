@@ -5,34 +5,87 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 static uint32_t round_up_inodes(uint32_t count) {
     // funcion local que redondea la cantidad de inodos para ocupar los bloques por completo
     return ((count + INODES_PER_BLOCK - 1) / INODES_PER_BLOCK * INODES_PER_BLOCK);
 }
 
+// Opciones que se pueden elegir con -O
+static const struct {
+    const char *name;
+    uint32_t flag;
+} feature_names[] = {
+    {"lazy_zero", VFS_FEATURE_LAZY_ZERO},
+    {"inode_bitmap", VFS_FEATURE_INODE_BITMAP},
+    {"extents", VFS_FEATURE_EXTENTS},
+    {"inline_data", VFS_FEATURE_INLINE_DATA},
+    {"relatime", VFS_FEATURE_RELATIME},
+    {"noatime", VFS_FEATURE_NOATIME},
+    {"dir_index", VFS_FEATURE_DIR_INDEX},
+};
+
+static int parse_features(char *list, uint32_t *features) {
+    // Interpreta una lista de opciones separadas por coma, por ejemplo "lazy_zero,^relatime"
+    // Una opción precedida por ^ se desactiva, para las que están activas por omisión
+    // Retorna 0, o -1 si alguna no existe
+    for (char *name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+        int disable = (name[0] == '^');
+        if (disable)
+            name++;
+
+        size_t i = 0;
+        while (i < sizeof(feature_names) / sizeof(feature_names[0]) && strcmp(name, feature_names[i].name) != 0)
+            i++;
+
+        if (i == sizeof(feature_names) / sizeof(feature_names[0])) {
+            fprintf(stderr, "Error: opción desconocida '%s'\n", name);
+            return -1;
+        }
+        if (disable)
+            *features &= ~feature_names[i].flag;
+        else
+            *features |= feature_names[i].flag;
+    }
+    return 0;
+}
+
 /*
     Crea el filesystem "vacio":
         Bloque 0: superblock
         Bloques 1 a N: area de nodos-I, el nodo-I 0 no se usa, el 1 es el directorio raiz
         Bloques N+1 a B: area de bitmap de bloques ocupados/libres
-        Bloque B+1: directorio raiz (unico), solo con entradas . y ..
+        Bloques B+1 a I: bitmap de nodos-I ocupados/libres (opcion inode_bitmap)
+        Bloque I+1: directorio raiz (unico), solo con entradas . y ..
 */
 int main(int argc, char *argv[]) {
-    if (argc != 4) {
-        fprintf(stderr, "Uso: %s <nombre_imagen> <total_bloques> <cantidad_nodosI>\n", argv[0]);
+    uint32_t features = VFS_DEFAULT_FEATURES;
+    int opt;
+    while ((opt = getopt(argc, argv, "O:")) != -1) {
+        if (opt != 'O' || parse_features(optarg, &features) != 0) {
+            fprintf(stderr, "Uso: %s [-O opcion[,opcion]] <nombre_imagen> <total_bloques> <cantidad_nodosI>\n",
+                    argv[0]);
+            fprintf(stderr, "Opciones: inode_bitmap y relatime (activas por omisión, ^opcion las desactiva), "
+                            "lazy_zero, inline_data, extents, noatime, dir_index\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - optind != 3) {
+        fprintf(stderr, "Uso: %s [-O opcion[,opcion]] <nombre_imagen> <total_bloques> <cantidad_nodosI>\n", argv[0]);
         return EXIT_FAILURE;
     }
 
-    const char *image_path = argv[1];
+    const char *image_path = argv[optind];
 
-    uint32_t total_blocks = (uint32_t)atoi(argv[2]);
+    uint32_t total_blocks = (uint32_t)atoi(argv[optind + 1]);
     if (total_blocks < VFS_MIN_BLOCKS || total_blocks >= VFS_MAX_BLOCKS) {
         fprintf(stderr, "Error: total_bloques debe ser un entero entre %d y %d.\n", VFS_MIN_BLOCKS, VFS_MAX_BLOCKS);
         return EXIT_FAILURE;
     }
 
-    uint32_t cantidad_nodosI = (uint32_t)atoi(argv[3]);
+    uint32_t cantidad_nodosI = (uint32_t)atoi(argv[optind + 2]);
     if (cantidad_nodosI < INODES_PER_BLOCK || cantidad_nodosI >= total_blocks) {
         fprintf(stderr, "Error: cantidad_nodosI debe ser mayor a %zu y no mayor a la cantidad de bloques.\n",
                 INODES_PER_BLOCK);
@@ -50,13 +103,32 @@ int main(int argc, char *argv[]) {
 
     uint32_t total_inodes = round_up_inodes(cantidad_nodosI);
 
-    if (init_superblock(image_path, total_blocks, total_inodes) != 0) {
+    struct vfs_device dev_struct, *dev = &dev_struct;
+    if (vfs_open(dev, image_path, VFS_OPEN_RDWR) != 0) {
+        fprintf(stderr, "Error al abrir el dispositivo de bloques: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    if (dev_init_superblock(dev, total_blocks, total_inodes, features) != 0) {
         fprintf(stderr, "Error: no se pudo inicializar el superbloque\n");
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
-    if (create_root_dir(image_path) != 0) {
+    if (dev_create_root_dir(dev) != 0) {
         fprintf(stderr, "Error: no se pudo crear el directorio raíz\n");
+        vfs_close(dev);
+        return EXIT_FAILURE;
+    }
+
+    if (vfs_flush(dev) != 0) {
+        fprintf(stderr, "Error al escribir los bloques pendientes en %s\n", image_path);
+        vfs_close(dev);
+        return EXIT_FAILURE;
+    }
+
+    if (vfs_close(dev) != 0) {
+        fprintf(stderr, "Error al cerrar el dispositivo de bloques: %s\n", strerror(errno));
         return EXIT_FAILURE;
     }
 
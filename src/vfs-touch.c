@@ -17,10 +17,18 @@ int main(int argc, char *argv[]) {
     const char *image_path = argv[1];
     int errors = 0;
 
+    // Open image
+    struct vfs_device dev_struct, *dev = &dev_struct;
+    if (vfs_open(dev, image_path, VFS_OPEN_RDWR) != 0) {
+        fprintf(stderr, "Error opening image %s: %s\n", image_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
     // Verify image
     struct superblock sb_struct, *sb = &sb_struct;
-    if (read_superblock(image_path, sb) != 0) {
+    if (dev_read_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error reading superblock\n");
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
@@ -36,13 +44,14 @@ int main(int argc, char *argv[]) {
         }
 
         // Check if file already exists
-        if (dir_lookup(image_path, filename) != 0) {
+        if (dev_dir_lookup(dev, filename) != 0) {
             fprintf(stderr, "File '%s' already exists\n", filename);
+            vfs_close(dev);
             return EXIT_FAILURE;
         }
 
         // Create empty file with default permissions (rw-r-----)
-        int new_inode = create_empty_file_in_free_inode(image_path, 0640);
+        int new_inode = dev_create_empty_file_in_free_inode(dev, 0640);
         if (new_inode < 0) {
             fprintf(stderr, "Error creating file '%s': %s\n", filename, strerror(errno));
             errors++;
@@ -50,10 +59,10 @@ int main(int argc, char *argv[]) {
         }
 
         // Add directory entry
-        if (add_dir_entry(image_path, filename, new_inode) != 0) {
+        if (dev_add_dir_entry(dev, filename, new_inode) != 0) {
             fprintf(stderr, "Error adding directory entry for '%s'\n", filename);
             // Free the inode we just allocated
-            free_inode(image_path, new_inode);
+            dev_free_inode(dev, new_inode);
             errors++;
             continue;
         }
@@ -61,5 +70,13 @@ int main(int argc, char *argv[]) {
         DEBUG_PRINT("File '%s' created successfully (inode %d)\n", filename, new_inode);
     }
 
+    // Write pending blocks to the image
+    if (vfs_flush(dev) != 0) {
+        fprintf(stderr, "Error writing pending blocks to %s\n", image_path);
+        vfs_close(dev);
+        return EXIT_FAILURE;
+    }
+
+    vfs_close(dev);
     return errors > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
\ No newline at end of file
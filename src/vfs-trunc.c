@@ -17,10 +17,18 @@ int main(int argc, char *argv[]) {
     const char *image_path = argv[1];
     int errors = 0;
 
+    // Open image
+    struct vfs_device dev_struct, *dev = &dev_struct;
+    if (vfs_open(dev, image_path, VFS_OPEN_RDWR) != 0) {
+        fprintf(stderr, "Error opening image %s: %s\n", image_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
     // Verify image
     struct superblock sb_struct, *sb = &sb_struct;
-    if (read_superblock(image_path, sb) != 0) {
+    if (dev_read_superblock(dev, sb) != 0) {
         fprintf(stderr, "Error reading superblock\n");
+        vfs_close(dev);
         return EXIT_FAILURE;
     }
 
@@ -29,7 +37,7 @@ int main(int argc, char *argv[]) {
         const char *filename = argv[i];
 
         // Look up file in directory
-        int inode_num = dir_lookup(image_path, filename);
+        int inode_num = dev_dir_lookup(dev, filename);
         if (inode_num == 0) {
             fprintf(stderr, "File '%s' not found\n", filename);
             errors++;
@@ -43,7 +51,7 @@ int main(int argc, char *argv[]) {
 
         // Read inode
         struct inode file_inode;
-        if (read_inode(image_path, inode_num, &file_inode) != 0) {
+        if (dev_read_inode(dev, inode_num, &file_inode) != 0) {
             fprintf(stderr, "Error reading inode for '%s'\n", filename);
             errors++;
             continue;
@@ -57,14 +65,14 @@ int main(int argc, char *argv[]) {
         }
 
         // Truncate the file
-        if (inode_trunc_data(image_path, &file_inode) != 0) {
+        if (dev_inode_trunc_data(dev, &file_inode) != 0) {
             fprintf(stderr, "Error truncating file '%s'\n", filename);
             errors++;
             continue;
         }
 
         // Write updated inode
-        if (write_inode(image_path, inode_num, &file_inode) != 0) {
+        if (dev_write_inode(dev, inode_num, &file_inode) != 0) {
             fprintf(stderr, "Error writing updated inode for '%s'\n", filename);
             errors++;
             continue;
@@ -73,5 +81,13 @@ int main(int argc, char *argv[]) {
         DEBUG_PRINT("File '%s' truncated successfully\n", filename);
     }
 
+    // Write pending blocks to the image
+    if (vfs_flush(dev) != 0) {
+        fprintf(stderr, "Error writing pending blocks to %s\n", image_path);
+        vfs_close(dev);
+        return EXIT_FAILURE;
+    }
+
+    vfs_close(dev);
     return errors > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
\ No newline at end of file
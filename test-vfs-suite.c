@@ -8,6 +8,7 @@
 #include <time.h>
 
 #define TEST_IMG "test_suite.img"
+#define LAZY_IMG "test_lazy.img"
 #define TEMP_FILE "temp_test.txt"
 #define MAX_CMD 512
 
@@ -89,6 +90,7 @@ int main() {
     // Limpiar antes de empezar
     cleanup_temp_files();
     unlink(TEST_IMG);
+    unlink(LAZY_IMG);
     
     // ==== PRUEBAS DE CREACIÓN DEL FILESYSTEM ====
     printf("\n%s--- PRUEBAS DE CREACIÓN DEL FILESYSTEM ---%s\n", YELLOW, RESET);
@@ -380,6 +382,259 @@ int main() {
     snprintf(cmd, MAX_CMD, "./vfs-ls %s | grep -E '^[[:space:]]*1.*d.*\\.\\.$'", TEST_IMG);
     run_test("Verificar entrada .. en raíz", cmd, 0);
     
+    // ==== PRUEBAS DE MODOS DE ACCESO A LA IMAGEN ====
+    printf("\n%s--- PRUEBAS DE MODOS DE ACCESO (VFS_IO) ---%s\n", YELLOW, RESET);
+
+    // Test 47: Leer con la imagen mapeada en memoria
+    snprintf(cmd, MAX_CMD, "VFS_IO=mmap ./vfs-cat %s big.bin > recovered_mmap.bin", TEST_IMG);
+    system(cmd);
+    run_test("Integridad leyendo con VFS_IO=mmap",
+             "diff -q test_big_integrity.bin recovered_mmap.bin", 0);
+
+    // Test 48: Listados iguales con pread y con mmap
+    snprintf(cmd, MAX_CMD, "./vfs-lsort %s > test_ls_pread.txt && VFS_IO=mmap ./vfs-lsort %s > test_ls_mmap.txt",
+             TEST_IMG, TEST_IMG);
+    system(cmd);
+    run_test("Listado igual con VFS_IO=mmap", "diff -q test_ls_pread.txt test_ls_mmap.txt", 0);
+
+    // Test 49: Crear archivos con mapeo solo lectura (las escrituras usan pwrite)
+    snprintf(cmd, MAX_CMD, "VFS_IO=mmap ./vfs-touch %s mmap_touch.txt && ./vfs-ls %s | grep -q mmap_touch.txt",
+             TEST_IMG, TEST_IMG);
+    run_test("Touch con VFS_IO=mmap", cmd, 0);
+
+    // Test 50: Copiar con mapeo lectura/escritura y verificar con pread
+    snprintf(cmd, MAX_CMD, "VFS_IO=mmap-rw ./vfs-copy %s test_big_integrity.bin big_mmap.bin", TEST_IMG);
+    system(cmd);
+    snprintf(cmd, MAX_CMD, "VFS_IO=pread ./vfs-cat %s big_mmap.bin > recovered_mmap_rw.bin", TEST_IMG);
+    system(cmd);
+    run_test("Integridad escribiendo con VFS_IO=mmap-rw",
+             "diff -q test_big_integrity.bin recovered_mmap_rw.bin", 0);
+
+    // Test 51: Modo desconocido, debe usar pread
+    snprintf(cmd, MAX_CMD, "VFS_IO=desconocido ./vfs-ls %s >/dev/null 2>&1", TEST_IMG);
+    run_test("VFS_IO inválido usa pread", cmd, 0);
+
+    // Test 52: Copiar y leer con io_uring (si no está disponible se usa pread)
+    // Las escrituras van por io_uring y las lecturas por el descriptor, no por un mapeo (reads en 0)
+    snprintf(cmd, MAX_CMD, "VFS_STATS=1 VFS_IO=uring VFS_QUEUE_DEPTH=4 ./vfs-copy %s test_big_integrity.bin "
+             "big_uring.bin 2> test_uring_stats.txt", TEST_IMG);
+    system(cmd);
+    snprintf(cmd, MAX_CMD, "VFS_STATS=1 VFS_IO=uring ./vfs-cat %s big_uring.bin 2>> test_uring_stats.txt "
+             "> recovered_uring.bin", TEST_IMG);
+    system(cmd);
+    run_test("Integridad con VFS_IO=uring",
+             "diff -q test_big_integrity.bin recovered_uring.bin && ! grep -q ' reads 0,' test_uring_stats.txt && "
+             "(grep -q 'io_uring enters [1-9]' test_uring_stats.txt || grep -q 'io_uring no disponible' "
+             "test_uring_stats.txt)", 0);
+
+    // Test 53: Asignar bloques con la búsqueda escalar en el bitmap
+    snprintf(cmd, MAX_CMD, "VFS_BITMAP_SCAN=scalar ./vfs-copy %s test_big_integrity.bin big_scalar.bin", TEST_IMG);
+    system(cmd);
+    snprintf(cmd, MAX_CMD, "./vfs-cat %s big_scalar.bin > recovered_scalar.bin", TEST_IMG);
+    system(cmd);
+    run_test("Integridad con VFS_BITMAP_SCAN=scalar",
+             "diff -q test_big_integrity.bin recovered_scalar.bin", 0);
+
+    // Test 54: Copiar en un hueco dejado por un archivo borrado (asignación por extents)
+    snprintf(cmd, MAX_CMD, "./vfs-rm %s big_scalar.bin && ./vfs-copy %s test_big_integrity.bin big_extent.bin && "
+             "./vfs-cat %s big_extent.bin > recovered_extent.bin", TEST_IMG, TEST_IMG, TEST_IMG);
+    system(cmd);
+    run_test("Integridad reutilizando bloques liberados",
+             "diff -q test_big_integrity.bin recovered_extent.bin", 0);
+
+    // Test 55: El superbloque muestra la pista de asignación
+    snprintf(cmd, MAX_CMD, "./vfs-info %s | grep -q 'Allocation hint'", TEST_IMG);
+    run_test("vfs-info muestra la pista de asignación", cmd, 0);
+
+    // Test 56: Borrar un archivo devuelve todos sus bloques (liberación en lote)
+    snprintf(cmd, MAX_CMD, "./vfs-info %s | grep 'Free blocks' > test_free_before.txt && "
+             "./vfs-copy %s test_big_integrity.bin big_free.bin && ./vfs-rm %s big_free.bin && "
+             "./vfs-info %s | grep 'Free blocks' | diff -q test_free_before.txt -", TEST_IMG, TEST_IMG, TEST_IMG,
+             TEST_IMG);
+    run_test("vfs-rm libera todos los bloques del archivo", cmd, 0);
+
+    // ==== PRUEBAS DE OPCIONES DE FORMATO ====
+    printf("\n%s--- PRUEBAS DE OPCIONES DE FORMATO (vfs-mkfs -O) ---%s\n", YELLOW, RESET);
+
+    // Test 57: Formatear con liberación sin ceros
+    snprintf(cmd, MAX_CMD, "./vfs-mkfs -O lazy_zero %s 1000 64 >/dev/null 2>&1 && ./vfs-info %s | grep -q lazy_zero",
+             LAZY_IMG, LAZY_IMG);
+    run_test("vfs-mkfs -O lazy_zero", cmd, 0);
+
+    // Test 58: Un archivo nuevo no ve el contenido de los bloques liberados sin limpiar
+    create_test_file("test_lazy_small.txt", "contenido corto que no llena un bloque\n", 0);
+    snprintf(cmd, MAX_CMD, "./vfs-copy %s test_big_integrity.bin big && ./vfs-rm %s big && "
+             "./vfs-copy %s test_lazy_small.txt small && ./vfs-cat %s small | diff -q test_lazy_small.txt -",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("Bloques reutilizados sin ceros no muestran datos viejos", cmd, 0);
+
+    // Test 59: Devolver el espacio al host al borrar
+    snprintf(cmd, MAX_CMD, "./vfs-copy %s test_big_integrity.bin big && VFS_ZERO=punch ./vfs-rm %s big && "
+             "./vfs-copy %s test_big_integrity.bin big2 && ./vfs-cat %s big2 | diff -q test_big_integrity.bin -",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("Borrar con VFS_ZERO=punch", cmd, 0);
+
+    // Test 60: Opción de formato desconocida
+    run_test("vfs-mkfs con opción desconocida", "./vfs-mkfs -O noexiste invalid.img 100 50 2>/dev/null", 1);
+
+    // Test 61: El bitmap de nodos-I reutiliza el nodo-I de un archivo borrado
+    snprintf(cmd, MAX_CMD, "./vfs-touch %s ia ib ic && B=$(./vfs-ls %s | awk '$NF == \"ib\" {print $1}') && "
+             "./vfs-rm %s ib && ./vfs-touch %s id && ./vfs-ls %s | awk -v b=\"$B\" '$NF == \"id\" {exit $1 != b}' && "
+             "./vfs-info %s | grep -q inode_bitmap", LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("Nodo-I liberado se reutiliza (bitmap de nodos-I)", cmd, 0);
+
+    // Test 62: Listado con y sin cache de nodos-I
+    snprintf(cmd, MAX_CMD, "./vfs-lsort %s > test_icache_on.txt && VFS_INODE_CACHE=0 ./vfs-lsort %s | "
+             "diff -q test_icache_on.txt -", LAZY_IMG, LAZY_IMG);
+    run_test("vfs-lsort con VFS_INODE_CACHE=0", cmd, 0);
+
+    unlink(LAZY_IMG);
+
+    // Test 63: Archivo de 1 MiB (más que el máximo con punteros) en nodos-I con extents
+    snprintf(cmd, MAX_CMD, "head -c 1048576 /dev/urandom > test_extents.bin && "
+             "./vfs-mkfs -O extents %s 4000 64 >/dev/null && ./vfs-info %s | grep 'Free blocks' > test_free_before.txt && "
+             "./vfs-copy %s test_extents.bin ext && ./vfs-cat %s ext | cmp -s test_extents.bin - && "
+             "./vfs-rm %s ext && ./vfs-info %s | grep 'Free blocks' | diff -q test_free_before.txt -",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("vfs-mkfs -O extents con un archivo de 1 MiB", cmd, 0);
+
+    unlink(LAZY_IMG);
+
+    // Test 64: Un archivo de pocos bytes queda en el nodo-I, sin bloques de datos
+    create_test_file("test_inline.txt", "clave=valor\n", 0);
+    snprintf(cmd, MAX_CMD, "./vfs-mkfs -O inline_data %s 200 32 >/dev/null && ./vfs-info %s | grep 'Free blocks' > test_free_before.txt && "
+             "./vfs-copy %s test_inline.txt cfg && ./vfs-cat %s cfg | diff -q test_inline.txt - && "
+             "./vfs-ls %s | awk '$NF == \"cfg\" {exit $5 != 0}' && "
+             "./vfs-info %s | grep 'Free blocks' | diff -q test_free_before.txt -",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("Archivo chico con los datos en el nodo-I (inline_data)", cmd, 0);
+
+    unlink(LAZY_IMG);
+
+    // Test 65: Los bloques en cero de un archivo copiado quedan como huecos
+    snprintf(cmd, MAX_CMD, "printf inicio > test_sparse.bin && truncate -s 200000 test_sparse.bin && "
+             "printf fin >> test_sparse.bin && ./vfs-mkfs %s 1000 64 >/dev/null && "
+             "A=$(./vfs-info %s | awk '/Free blocks/ {print $3}') && ./vfs-copy %s test_sparse.bin sp && "
+             "./vfs-cat %s sp | cmp -s test_sparse.bin - && "
+             "B=$(./vfs-info %s | awk '/Free blocks/ {print $3}') && [ $((A - B)) -le 3 ]",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("vfs-copy deja huecos en los bloques en cero", cmd, 0);
+
+    // Test 66: Copiar un archivo escribe cada bloque de datos una vez, sin leerlos
+    snprintf(cmd, MAX_CMD, "head -c 204800 /dev/urandom > test_rmw.bin && VFS_STATS=1 ./vfs-copy %s test_rmw.bin rmw 2>&1 | "
+             "awk '/KiB written/ {r = $4; w = $7} END {exit !(r < 16 && w >= 200 && w < 216)}' && "
+             "./vfs-cat %s rmw | cmp -s test_rmw.bin -", LAZY_IMG, LAZY_IMG);
+    run_test("vfs-copy sin lectura-modificación-escritura", cmd, 0);
+
+    // Test 67: Con noatime, leer un archivo no escribe en la imagen
+    snprintf(cmd, MAX_CMD, "VFS_STATS=1 VFS_ATIME=noatime ./vfs-cat %s rmw 2>&1 >/dev/null | grep -q ' writes 0,' && "
+             "VFS_STATS=1 VFS_ATIME=strict ./vfs-cat %s rmw 2>&1 >/dev/null | grep -q ' writes 1,'",
+             LAZY_IMG, LAZY_IMG);
+    run_test("vfs-cat con VFS_ATIME=noatime no escribe", cmd, 0);
+
+    // Test 68: vfs-cat copia por partes, con sendfile o, si la salida no lo admite (O_APPEND), con un buffer
+    snprintf(cmd, MAX_CMD, "head -c 266000 /dev/urandom > test_stream.bin && ./vfs-copy %s test_stream.bin st && "
+             "cat test_stream.bin test_rmw.bin > test_stream_all.bin && "
+             "./vfs-cat %s st rmw | cmp -s test_stream_all.bin - && rm -f stream_out.bin && "
+             "./vfs-cat %s st rmw >> stream_out.bin && cmp -s test_stream_all.bin stream_out.bin",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("vfs-cat por partes, con sendfile y con buffer", cmd, 0);
+
+    unlink(LAZY_IMG);
+
+    // Test 69: El directorio raíz crece más allá de su primer bloque y reutiliza las entradas borradas
+    snprintf(cmd, MAX_CMD, "./vfs-mkfs %s 4000 1200 >/dev/null 2>&1 && ./vfs-touch %s $(seq -f d%%g 1 1000) && "
+             "./vfs-ls %s | grep -c ' d[0-9]*$' | grep -qx 1000 && ./vfs-rm %s d7 && ./vfs-touch %s nuevo && "
+             "./vfs-info %s | grep -q 'directory entry hint: 9$' && ./vfs-ls %s | grep -q ' nuevo$'",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("Directorio raíz con 1000 archivos", cmd, 0);
+
+    unlink(LAZY_IMG);
+
+    // Test 70: Directorio con índice de hash: altas, bajas y búsquedas; vfs-ls lo sigue leyendo en forma lineal
+    snprintf(cmd, MAX_CMD, "./vfs-mkfs -O dir_index %s 4000 1200 >/dev/null 2>&1 && ./vfs-touch %s $(seq -f h%%g 1 1000) && "
+             "./vfs-rm %s $(seq -f h%%g 1 2 1000) && ./vfs-ls %s | grep -c ' h[0-9]*$' | grep -qx 500 && "
+             "! ./vfs-copy %s test_small.txt h2 2>/dev/null && ./vfs-copy %s test_small.txt h3 && "
+             "./vfs-cat %s h3 | diff -q test_small.txt - && ! ./vfs-cat %s h999 2>/dev/null",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("vfs-mkfs -O dir_index con 1000 archivos", cmd, 0);
+
+    unlink(LAZY_IMG);
+
+    // Test 71: Las variantes del recorrido de bloques de directorio encuentran las mismas entradas
+    snprintf(cmd, MAX_CMD, "./vfs-mkfs %s 4000 1200 >/dev/null 2>&1 && ./vfs-touch %s $(seq -f s%%g 1 100) && "
+             "./vfs-rm %s s50 && for v in scalar sse2 avx2; do "
+             "VFS_DIR_SCAN=$v ./vfs-cat %s s100 2>/dev/null && ! VFS_DIR_SCAN=$v ./vfs-cat %s s50 2>/dev/null && "
+             "VFS_DIR_SCAN=$v ./vfs-touch %s s50 2>/dev/null && VFS_DIR_SCAN=$v ./vfs-rm %s s50 2>/dev/null || exit 1; "
+             "done && ./vfs-info %s | grep -q 'directory entry hint: 51$'",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("VFS_DIR_SCAN=scalar|sse2|avx2 con 100 archivos", cmd, 0);
+
+    unlink(LAZY_IMG);
+
+    // Test 72: Cache de entradas: un comando con muchos nombres recorre el directorio una sola vez
+    snprintf(cmd, MAX_CMD, "./vfs-mkfs %s 4000 1200 >/dev/null 2>&1 && ./vfs-touch %s $(seq -f c%%g 1 300) && "
+             "VFS_STATS=1 ./vfs-cat %s $(seq -f c%%g 1 300) 2>&1 | grep -q 'misses 1, directory scans 1$' && "
+             "VFS_STATS=1 ./vfs-rm %s $(seq -f c%%g 1 2 300) 2>&1 | grep -q 'misses 1, directory scans 1$' && "
+             "! ./vfs-cat %s c1 2>/dev/null && VFS_DENTRY_CACHE=0 ./vfs-touch %s c1 c2 2>/dev/null; "
+             "./vfs-ls %s | grep -c ' c[0-9]*$' | grep -qx 151",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("Cache de entradas con 300 archivos", cmd, 0);
+
+    unlink(LAZY_IMG);
+
+    // Test 73: vfs-lsort por tamaño, por nodo-I y en orden inverso
+    create_test_file("test_lsort.bin", NULL, 20000);
+    snprintf(cmd, MAX_CMD, "./vfs-mkfs %s 2000 200 >/dev/null 2>&1 && ./vfs-copy %s test_small.txt chico && "
+             "./vfs-copy %s test_lsort.bin grande && ./vfs-touch %s vacio && "
+             "./vfs-lsort -k size %s | sed -n 3p | grep -q ' grande$' && "
+             "./vfs-lsort -r -k size %s | sed -n 3p | grep -q ' vacio$' && ./vfs-lsort -r %s | tail -1 | grep -q ' \\.$' && "
+             "./vfs-lsort -k inode %s | tail -n +3 | sort -c -n && ! ./vfs-lsort -k color %s 2>/dev/null",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("vfs-lsort -k size|inode y -r", cmd, 0);
+
+    unlink(LAZY_IMG);
+    unlink("test_lsort.bin");
+
+    // Test 74: Un nodo-I en uso sin su bit en el bitmap (asignado por un programa anterior) no se reasigna
+    snprintf(cmd, MAX_CMD, "./vfs-mkfs %s 2000 200 >/dev/null 2>&1 && ./vfs-touch %s b a c && ./vfs-rm %s a && "
+             "printf '\\340' | dd of=%s bs=1 seek=15360 conv=notrunc 2>/dev/null && ./vfs-touch %s x y && "
+             "./vfs-ls %s | awk '{print $1, $NF}' | grep -qx '5 y' && ./vfs-ls %s | grep -q ' c$'",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("Nodo-I en uso sin su bit en el bitmap", cmd, 0);
+
+    unlink(LAZY_IMG);
+
+    // Test 75: Un hueco en el directorio raíz (primer puntero en 0) no se lee como el bloque 0
+    snprintf(cmd, MAX_CMD, "./vfs-mkfs %s 2000 200 >/dev/null && ./vfs-touch %s $(seq 40) && "
+             "dd if=/dev/zero of=%s bs=1 seek=1100 count=4 conv=notrunc 2>/dev/null && "
+             "! ./vfs-ls %s 2>&1 | grep -q Error && ! ./vfs-lsort %s 2>&1 | grep -q Error && "
+             "VFS_DENTRY_CACHE=0 ./vfs-rm %s 40 && ./vfs-rm %s 39 && ./vfs-ls %s | grep -q ' 38$'",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("Hueco en el directorio raíz", cmd, 0);
+
+    unlink(LAZY_IMG);
+
+    // Test 76: vfs-ls y vfs-lsort -k blocks cuentan los bloques asignados, no los huecos
+    create_test_file("test_dense.bin", NULL, 5000);
+    snprintf(cmd, MAX_CMD, "./vfs-mkfs %s 1000 64 >/dev/null && ./vfs-copy %s test_sparse.bin sp && "
+             "./vfs-copy %s test_dense.bin d && ./vfs-ls %s | awk '$NF == \"sp\" {exit $5 != 2}' && "
+             "./vfs-lsort -k blocks %s | sed -n 3p | grep -q ' d$'",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("Bloques asignados de un archivo con huecos", cmd, 0);
+
+    unlink(LAZY_IMG);
+    unlink("test_dense.bin");
+
+    // Test 77: Un nodo-I libre con su bit todavía en el bitmap (liberado por un programa anterior) se reusa
+    snprintf(cmd, MAX_CMD, "./vfs-mkfs %s 2000 16 >/dev/null && ./vfs-touch %s a b c d e f g h i j k l m n && "
+             "./vfs-rm %s d && printf '\\377' | dd of=%s bs=1 seek=3072 conv=notrunc 2>/dev/null && "
+             "./vfs-touch %s nuevo && ./vfs-ls %s | awk '{print $1, $NF}' | grep -qx '5 nuevo'",
+             LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG, LAZY_IMG);
+    run_test("Nodo-I libre con su bit en el bitmap", cmd, 0);
+
+    unlink(LAZY_IMG);
+
     // ==== RESUMEN FINAL ====
     printf("\n%s=========================================%s\n", YELLOW, RESET);
     printf("%sRESUMEN DE PRUEBAS%s\n", YELLOW, RESET);